@@ -0,0 +1,195 @@
+// $Id$
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#include "animate.h"
+#include "debug.h"
+#include "pool.h"
+#include "profile.h"
+#include "trace.h"
+#include "util.h"
+
+vector<GLfloat> animation::xvelocity;
+vector<GLfloat> animation::yvelocity;
+size_t animation::velocity_end = 0;
+vector<animation::path> animation::paths;
+bool animation::paths_sorted = true;
+vector<vertex> animation::waypoints;
+vector<size_t> animation::moving_;
+bool animation::moving_sorted = true;
+double animation::pending = 0;
+double animation::sim_time = 0;
+
+void animation::add_moving (size_t slot) {
+   if (not moving_.empty() and moving_.back() >= slot) {
+      moving_sorted = false;
+   }
+   moving_.push_back (slot);
+}
+
+void animation::clear() {
+   xvelocity.clear();
+   yvelocity.clear();
+   velocity_end = 0;
+   paths.clear();
+   paths_sorted = true;
+   waypoints.clear();
+   moving_.clear();
+   moving_sorted = true;
+}
+
+const vector<size_t>& animation::moving() {
+   if (not moving_sorted) {
+      sort (moving_.begin(), moving_.end());
+      moving_.erase (unique (moving_.begin(), moving_.end()),
+                     moving_.end());
+      moving_sorted = true;
+   }
+   return moving_;
+}
+
+//
+// Velocities are kept as columns indexed by slot, like the scene's
+// positions, so one loop with no gathers applies them all.
+//
+void animation::set_velocity (size_t slot, GLfloat xvel, GLfloat yvel) {
+   if (xvelocity.size() <= slot) {
+      xvelocity.resize (slot + 1);
+      yvelocity.resize (slot + 1);
+   }
+   xvelocity[slot] = xvel;
+   yvelocity[slot] = yvel;
+   velocity_end = max (velocity_end, slot + 1);
+   add_moving (slot);
+}
+
+//
+// The loop starts and ends at the object's own center.
+//
+void animation::add_path (size_t slot, GLfloat period,
+                          const vertex_list& points) {
+   path track {slot, uint32_t (waypoints.size()),
+               uint32_t (points.size() + 1), period, 0, {0.0f, 0.0f}};
+   waypoints.push_back (vertex (0.0f, 0.0f));
+   waypoints.insert (waypoints.end(), points.begin(), points.end());
+   for (uint32_t index = 0; index < track.count; ++index) {
+      const vertex& from = waypoints[track.first + index];
+      const vertex& to = waypoints[track.first
+                                   + (index + 1) % track.count];
+      track.length += hypot (to.xpos - from.xpos, to.ypos - from.ypos);
+   }
+   if (not paths.empty() and paths.back().slot > slot) {
+      paths_sorted = false;
+   }
+   paths.push_back (track);
+   add_moving (slot);
+}
+
+vertex animation::path_offset (const path& track, double time) {
+   if (track.length == 0 or track.period <= 0) return vertex (0.0f, 0.0f);
+   double phase = fmod (time, track.period) / track.period;
+   double distance = phase * track.length;
+   for (uint32_t index = 0; index < track.count; ++index) {
+      const vertex& from = waypoints[track.first + index];
+      const vertex& to = waypoints[track.first
+                                   + (index + 1) % track.count];
+      double segment = hypot (to.xpos - from.xpos, to.ypos - from.ypos);
+      if (distance <= segment and segment > 0) {
+         double part = distance / segment;
+         return vertex (from.xpos + (to.xpos - from.xpos) * part,
+                        from.ypos + (to.ypos - from.ypos) * part);
+      }
+      distance -= segment;
+   }
+   return vertex (0.0f, 0.0f);
+}
+
+//
+// One step for the slots from first up to last: their velocities,
+// then their paths, which are sorted by slot.  Slices of different
+// slots touch disjoint slots, so they can run on separate threads.
+//
+void animation::step_slice (scene_store& scene, size_t first,
+                            size_t last) {
+   scene.advance (first, min (last, velocity_end), xvelocity.data(),
+                  yvelocity.data(), step_seconds);
+   auto by_slot = [] (const path& track, size_t slot) {
+      return track.slot < slot;
+   };
+   size_t first_path = lower_bound (paths.begin(), paths.end(), first,
+                                    by_slot) - paths.begin();
+   size_t last_path = lower_bound (paths.begin(), paths.end(), last,
+                                   by_slot) - paths.begin();
+   for (size_t index = first_path; index < last_path; ++index) {
+      path& track = paths[index];
+      vertex offset = path_offset (track, sim_time + step_seconds);
+      vertex center = scene.center (track.slot);
+      scene.set_center (track.slot,
+                        vertex (center.xpos + offset.xpos
+                                            - track.offset.xpos,
+                                center.ypos + offset.ypos
+                                            - track.offset.ypos));
+      track.offset = offset;
+   }
+}
+
+//
+// Slices are at least min_slice slots, so ordinary scenes step on
+// the calling thread.  Larger ones are cut into equal ranges of
+// slots, run on a pool made the first time it is needed.
+//
+int animation::advance (scene_store& scene, double seconds) {
+   static constexpr size_t min_slice = 1 << 16;
+   pending = min (pending + seconds, max_steps * step_seconds);
+   int steps = int (pending / step_seconds);
+   if (steps == 0 or moving_.empty()) return 0;
+   TRACE_SCOPE ('a', "advance", steps);
+   pending -= steps * step_seconds;
+   velocity_end = min (velocity_end, scene.size());
+   if (not paths_sorted) {
+      stable_sort (paths.begin(), paths.end(),
+                   [] (const path& one, const path& two) {
+                      return one.slot < two.slot;
+                   });
+      paths_sorted = true;
+   }
+   size_t slot_end = velocity_end;
+   if (not paths.empty()) {
+      slot_end = max (slot_end, paths.back().slot + 1);
+   }
+   size_t cores = max (thread::hardware_concurrency(), 1u);
+   size_t slices = max<size_t> (1, min (cores, slot_end / min_slice));
+   static unique_ptr<work_pool> pool;
+   if (slices > 1 and pool == nullptr) {
+      pool.reset (new work_pool (cores));
+   }
+   function<void(size_t,size_t)> slice_task = [&] (size_t slice,
+                                                   size_t) {
+      step_slice (scene, slot_end * slice / slices,
+                  slot_end * (slice + 1) / slices);
+   };
+   auto start = profiler::clock::now();
+   for (int step = 0; step < steps; ++step) {
+      if (slices == 1) {
+         step_slice (scene, 0, slot_end);
+      }else {
+         pool->run (slices, slice_task);
+      }
+      sim_time += step_seconds;
+   }
+   if (profiler::enabled()) {
+      chrono::duration<double> elapsed = profiler::clock::now() - start;
+      profiler::add_update (elapsed.count(), steps, moving().size());
+   }
+   DEBUGF ('a', steps << " steps, " << slices << " slices, "
+           << moving_.size() << " moving");
+   return steps;
+}
+
@@ -0,0 +1,78 @@
+// $Id$
+
+#ifndef __ANIMATE_H__
+#define __ANIMATE_H__
+
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+#include <GL/freeglut.h>
+
+#include "scene.h"
+#include "shape.h"
+
+//
+// animation -
+//    Static class that moves objects on a fixed timestep, separately
+//    from drawing them.  An object may have a velocity, in pixels per
+//    second, and a path, a loop of waypoints relative to its center
+//    that it follows at constant speed, once every period seconds.
+//    Both may be set; the path's offset is added to the motion from
+//    the velocity, and to any moves from the keyboard.
+// advance -
+//    Run every whole step of seconds that has built up since the
+//    last call, leaving the remainder for the next, at most
+//    max_steps at a time so a slow frame does not snowball.
+//    Velocities are applied by one loop over the position columns,
+//    cut into slices of slots for a pool of threads when there are
+//    enough objects.  Each slice also follows the paths of its own
+//    slots.  Returns the number of steps run.
+// moving -
+//    Slots with a velocity or a path, in increasing order, for the
+//    window to update its index and damage after advance.
+// clear -
+//    Forget every velocity and path, for a scene that is being
+//    replaced.  Time goes on from where it was.
+//
+
+class animation {
+   public:
+      static constexpr double step_seconds = 1.0 / 60;
+      static const int max_steps = 8;
+   private:
+      struct path {
+         size_t slot;
+         uint32_t first;      // first waypoint
+         uint32_t count;      // waypoints, including the origin
+         GLfloat period;
+         GLfloat length;      // around the whole loop
+         vertex offset;       // where the path has put the object
+      };
+      static vector<GLfloat> xvelocity;
+      static vector<GLfloat> yvelocity;
+      static size_t velocity_end;
+      static vector<path> paths;
+      static bool paths_sorted;
+      static vector<vertex> waypoints;
+      static vector<size_t> moving_;
+      static bool moving_sorted;
+      static double pending;
+      static double sim_time;
+      static void add_moving (size_t slot);
+      static vertex path_offset (const path& track, double time);
+      static void step_slice (scene_store& scene, size_t first,
+                              size_t last);
+   public:
+      animation() = delete;
+      static void set_velocity (size_t slot, GLfloat xvel, GLfloat yvel);
+      static void add_path (size_t slot, GLfloat period,
+                            const vertex_list& points);
+      static void clear();
+      static bool active() { return not moving_.empty(); }
+      static const vector<size_t>& moving();
+      static int advance (scene_store& scene, double seconds);
+};
+
+#endif
+
@@ -0,0 +1,76 @@
+// $Id$
+
+#include <iomanip>
+#include <new>
+using namespace std;
+
+#include "arena.h"
+
+bool shape_arena::pooled = false;
+atomic<size_t> shape_arena::shapes {0};
+
+char* arena::new_block (size_t bytes) {
+   blocks.emplace_back (new char[bytes]);
+   ++usage_.blocks;
+   usage_.reserved += bytes;
+   return blocks.back().get();
+}
+
+void* arena::do_allocate (size_t bytes, size_t alignment) {
+   lock_guard<mutex> guard (lock);
+   ++usage_.allocations;
+   usage_.bytes += bytes;
+   if (not pooled) return ::operator new (bytes, align_val_t (alignment));
+   if (bytes > block_size / 4) {
+      void* where = new_block (bytes + alignment);
+      size_t space = bytes + alignment;
+      return align (alignment, bytes, where, space);
+   }
+   void* where = next;
+   size_t space = end - next;
+   if (align (alignment, bytes, where, space) == nullptr) {
+      next = new_block (block_size);
+      end = next + block_size;
+      where = next;
+      space = block_size;
+      align (alignment, bytes, where, space);
+   }
+   next = static_cast<char*> (where) + bytes;
+   return where;
+}
+
+void arena::do_deallocate (void* where, size_t bytes, size_t alignment) {
+   if (not pooled) {
+      ::operator delete (where, bytes, align_val_t (alignment));
+   }
+}
+
+arena::usage arena::get_usage() {
+   lock_guard<mutex> guard (lock);
+   return usage_;
+}
+
+arena& shape_arena::memory() {
+   static arena& heap = *new arena (false);
+   static arena& pool = *new arena (true);
+   return pooled ? pool : heap;
+}
+
+void shape_arena::report (ostream& out) {
+   arena::usage used = memory().get_usage();
+   out << "arena: " << shapes << " shapes, " << used.allocations
+       << " allocations, " << used.bytes << " bytes";
+   if (shapes != 0) {
+      out << fixed << setprecision (1) << " ("
+          << double (used.bytes) / shapes << " per shape)"
+          << defaultfloat;
+   }
+   if (pooled) {
+      out << " in " << used.blocks << " blocks of " << used.reserved
+          << " bytes";
+   }else {
+      out << " from the heap";
+   }
+   out << endl;
+}
+
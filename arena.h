@@ -0,0 +1,99 @@
+// $Id$
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+//
+// arena -
+//    Memory resource that counts what is allocated from it.  Pooled,
+//    it carves allocations out of large blocks and frees nothing
+//    until it is destroyed, for data that lives as long as the
+//    scene; a request over a quarter of a block gets a block of its
+//    own.  Not pooled, it passes every call on to the heap.  Safe to
+//    use from any thread.
+//
+
+class arena: public pmr::memory_resource {
+   public:
+      static const size_t block_size = 1 << 20;
+      struct usage {
+         size_t allocations {0};
+         size_t bytes {0};        // all ever requested
+         size_t blocks {0};
+         size_t reserved {0};     // in blocks
+      };
+   private:
+      const bool pooled;
+      mutex lock;
+      vector<unique_ptr<char[]>> blocks;
+      char* next {nullptr};
+      char* end {nullptr};
+      usage usage_;
+      char* new_block (size_t bytes);
+      virtual void* do_allocate (size_t bytes, size_t alignment) override;
+      virtual void do_deallocate (void* where, size_t bytes,
+                                  size_t alignment) override;
+      virtual bool do_is_equal (const memory_resource& other)
+                   const noexcept override {
+         return this == &other;
+      }
+   public:
+      explicit arena (bool pooled): pooled(pooled) {}
+      arena (const arena&) = delete;
+      arena& operator= (const arena&) = delete;
+      usage get_usage();
+};
+
+//
+// shape_arena -
+//    Static class for the memory that shapes, their vertex and index
+//    arrays, and the scene's copies of those arrays come from.  Once
+//    enabled (gdraw -m) that is a pooled arena: shapes live in the
+//    interpreter's objmap and geometry cache for the whole run, so
+//    there is nothing to gain from freeing them one at a time.
+//    Otherwise it is the heap, counted the same way, so the two can
+//    be compared.  Neither is ever destroyed, so shapes still held by
+//    statics at exit are safe.  Only the first load is pooled: the
+//    shapes a reload replaces would never be given back.
+// enable, disable -
+//    Use the pooled arena, or the heap, for shapes made from now on.
+// resource -
+//    Where a shape's arrays are allocated.
+// make -
+//    As make_shared, but with the shape and its control block in
+//    resource().
+// report -
+//    Shapes made, allocations and bytes, and bytes per shape.
+//
+
+class shape_arena {
+   private:
+      static bool pooled;
+      static atomic<size_t> shapes;
+      static arena& memory();
+   public:
+      shape_arena() = delete;
+      static void enable() { pooled = true; }
+      static void disable() { pooled = false; }
+      static bool enabled() { return pooled; }
+      static pmr::memory_resource* resource() { return &memory(); }
+      template <typename shape_t, typename... args_t>
+      static shared_ptr<shape_t> make (args_t&&... args) {
+         ++shapes;
+         return allocate_shared<shape_t> (
+                pmr::polymorphic_allocator<shape_t> (resource()),
+                forward<args_t> (args)...);
+      }
+      static void report (ostream& out);
+};
+
+#endif
+
@@ -0,0 +1,182 @@
+// $Id$
+
+#include <chrono>
+#include <vector>
+using namespace std;
+
+#include "batch.h"
+#include "debug.h"
+#include "profile.h"
+#include "render.h"
+#include "trace.h"
+#include "util.h"
+
+void render_list::build (const scene_store& scene) {
+   TRACE_SCOPE ('b', "build", scene.size());
+   vertices_.clear();
+   colors_.clear();
+   placements.clear();
+   placements.reserve (scene.size());
+   const GLfloat* xpos = scene.xpos();
+   const GLfloat* ypos = scene.ypos();
+   const rgbcolor* colors = scene.colors();
+   for (const auto& run: scene.spans()) {
+      size_t end = run.first + run.count;
+      if (run.kind == shape_kind::text) {
+         for (size_t slot = run.first; slot < end; ++slot) {
+            placements.push_back ({vertices_.size(), 0,
+                                   vertex (xpos[slot], ypos[slot])});
+         }
+         continue;
+      }
+      for (size_t slot = run.first; slot < end; ++slot) {
+         const vertex_list& local = scene.geometry_of (slot).triangles;
+         size_t first = vertices_.size();
+         vertices_.resize (first + local.size());
+         transform_vertices (scene.transform (slot), local.data(),
+                             local.size(), &vertices_[first]);
+         colors_.insert (colors_.end(), local.size(), colors[slot]);
+         placements.push_back ({first, local.size(),
+                                vertex (xpos[slot], ypos[slot])});
+      }
+   }
+   dirty_begin = dirty_end = 0;
+   rebuilt = true;
+   DEBUGF ('b', scene.size() << " objects, " << vertices_.size()
+           << " vertices");
+}
+
+void render_list::move (size_t slot, const vertex& center) {
+   placement& place = placements[slot];
+   GLfloat delta_x = center.xpos - place.center.xpos;
+   GLfloat delta_y = center.ypos - place.center.ypos;
+   place.center = center;
+   if (place.count == 0) return;
+   for (size_t index = place.first;
+        index < place.first + place.count; ++index) {
+      vertices_[index].xpos += delta_x;
+      vertices_[index].ypos += delta_y;
+   }
+   if (dirty_begin == dirty_end) {
+      dirty_begin = place.first;
+      dirty_end = place.first + place.count;
+   }else {
+      dirty_begin = min (dirty_begin, place.first);
+      dirty_end = max (dirty_end, place.first + place.count);
+   }
+}
+
+void render_list::submit (const scene_store& scene,
+                          const vector<size_t>& visible) {
+   TRACE_SCOPE ('b', "submit", visible.size());
+   render_backend& backend = render::backend();
+   if (backend.draws_instances()) {
+      submit_instances (scene, visible);
+      return;
+   }
+   bool timed = profiler::enabled();
+   size_t first = 0;
+   size_t count = 0;
+   uint16_t class_id = 0;
+   size_t runs = 0;
+   auto flush = [&] () {
+      if (count == 0) return;
+      if (timed) {
+         auto start = profiler::clock::now();
+         backend.draw_triangles (*this, first, count);
+         chrono::duration<double> elapsed = profiler::clock::now()
+                                          - start;
+         profiler::add (class_id, elapsed.count());
+      }else {
+         backend.draw_triangles (*this, first, count);
+      }
+      count = 0;
+      ++runs;
+   };
+   for (size_t slot: visible) {
+      const placement& place = placements[slot];
+      uint16_t slot_class = timed ? scene.geometry_of (slot).class_id
+                                  : 0;
+      if (place.count == 0) {
+         flush();
+         if (timed) {
+            auto start = profiler::clock::now();
+            scene.draw (slot);
+            chrono::duration<double> elapsed = profiler::clock::now()
+                                             - start;
+            profiler::add (slot_class, elapsed.count());
+         }else {
+            scene.draw (slot);
+         }
+      }else if (count > 0 and first + count == place.first
+                and slot_class == class_id) {
+         count += place.count;
+      }else {
+         flush();
+         first = place.first;
+         count = place.count;
+         class_id = slot_class;
+      }
+   }
+   flush();
+   DEBUGF ('b', visible.size() << " objects, " << runs << " runs");
+}
+
+
+//
+// A run is consecutive listed objects with the same geometry and the
+// same rotation and scale, so drawing each run in turn keeps
+// painter's order.
+//
+static bool same_linear (const scene_store& scene, size_t slot,
+                         size_t other) {
+   return scene.angles()[slot] == scene.angles()[other]
+      and scene.xscales()[slot] == scene.xscales()[other]
+      and scene.yscales()[slot] == scene.yscales()[other];
+}
+
+//
+// The instance arrays are kept per thread, since a tiled backend
+// submits a bin from each of its workers at once.
+//
+void render_list::submit_instances (const scene_store& scene,
+                                    const vector<size_t>& visible) {
+   static thread_local vertex_list instance_centers;
+   static thread_local vector<rgbcolor> instance_colors;
+   render_backend& backend = render::backend();
+   bool timed = profiler::enabled();
+   size_t run_slot = 0;
+   size_t runs = 0;
+   auto flush = [&] () {
+      size_t count = instance_centers.size();
+      if (count == 0) return;
+      const scene_store::geometry& info = scene.geometry_of (run_slot);
+      auto start = profiler::clock::now();
+      transform2d linear = scene.transform (run_slot);
+      linear.offset = vertex (0.0f, 0.0f);
+      backend.draw_instances (scene.geometry_id (run_slot), info, linear,
+                              instance_centers.data(),
+                              instance_colors.data(), count);
+      if (timed) {
+         chrono::duration<double> elapsed = profiler::clock::now()
+                                          - start;
+         profiler::add (info.class_id, elapsed.count());
+      }
+      instance_centers.clear();
+      instance_colors.clear();
+      ++runs;
+   };
+   for (size_t slot: visible) {
+      if (not instance_centers.empty()
+          and (scene.geometry_id (slot) != scene.geometry_id (run_slot)
+               or not same_linear (scene, slot, run_slot))) {
+         flush();
+      }
+      if (instance_centers.empty()) run_slot = slot;
+      instance_centers.push_back (scene.center (slot));
+      instance_colors.push_back (scene.color (slot));
+   }
+   flush();
+   DEBUGF ('b', visible.size() << " objects, " << runs
+           << " instance runs");
+}
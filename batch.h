@@ -0,0 +1,71 @@
+// $Id$
+
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <vector>
+using namespace std;
+
+#include <GL/freeglut.h>
+
+#include "rgbcolor.h"
+#include "scene.h"
+#include "shape.h"
+
+//
+// render_list -
+//    Retained geometry for a whole scene.  Every object that can be
+//    tessellated is packed into one contiguous world-space triangle
+//    list, in object order, with a parallel per-vertex color array.
+// build -
+//    Rebuild everything from the scene store.
+// move -
+//    An object's center changed.  Its vertices are translated in
+//    place and the range is marked dirty for the next upload.
+// submit -
+//    Draw the listed objects, given in increasing order, through the
+//    current render backend.  Objects whose vertices are adjacent in
+//    the list are merged into a single run, drawn with one call.
+//    Objects that cannot be tessellated (text) are drawn on their own
+//    and split the runs, so painter's order is kept.  While the
+//    profiler is on, runs are also split where the shape class
+//    changes, and each is timed and charged to its class.
+//    If the backend draws instances, consecutive listed objects that
+//    share a geometry, text included, are handed over together as
+//    instances instead, with their centers and colors.
+//
+
+class render_list {
+   public:
+      struct placement {
+         size_t first;    // first vertex of the object's triangles
+         size_t count;    // vertex count, zero for an immediate object
+         vertex center;
+      };
+   private:
+      vertex_list vertices_;
+      vector<rgbcolor> colors_;
+      vector<placement> placements;
+      size_t dirty_begin {0};
+      size_t dirty_end {0};
+      bool rebuilt {true};
+      GLuint buffer_ {0};
+      size_t buffer_size_ {0};
+      friend class gl_backend;
+      void submit_instances (const scene_store& scene,
+                             const vector<size_t>& visible);
+   public:
+      render_list() {}
+      render_list (const render_list&) = delete;
+      render_list& operator= (const render_list&) = delete;
+      void build (const scene_store& scene);
+      void move (size_t slot, const vertex& center);
+      void submit (const scene_store& scene,
+                   const vector<size_t>& visible);
+      const vertex* vertices() const { return vertices_.data(); }
+      const rgbcolor* colors() const { return colors_.data(); }
+      size_t size() const { return vertices_.size(); }
+};
+
+#endif
+
@@ -0,0 +1,235 @@
+// $Id$
+
+//
+// gdraw-bench -
+//    Throughput of the CPU raster backend on a synthetic scene.
+//    Draws a fixed mix of shapes at pseudo-random positions into an
+//    in-memory framebuffer and reports shapes/sec and pixels/sec.
+//    Then compares the per-object passes over a vector<object>
+//    against the same passes over a scene_store, and times the same
+//    scene drawn as -t pixel tiles on 1, 2, 4, ... threads, up to -j.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+#include "batch.h"
+#include "debug.h"
+#include "graphics.h"
+#include "raster.h"
+#include "render.h"
+#include "scene.h"
+#include "shape.h"
+#include "util.h"
+
+vector<object> make_scene (size_t count, int width, int height) {
+   vector<shape_ptr> kinds {
+      make_shared<rectangle> (GLfloat (60), GLfloat (40)),
+      make_shared<square> (GLfloat (30)),
+      make_shared<circle> (GLfloat (40)),
+      make_shared<ellipse> (GLfloat (50), GLfloat (25)),
+      make_shared<triangle> (vertex (-20.0f, -20.0f),
+                             vertex (20.0f, -20.0f),
+                             vertex (0.0f, 30.0f)),
+      make_shared<diamond> (GLfloat (40), GLfloat (60)),
+      make_shared<text> (string ("Helvetica-18"), "Benchmark"),
+   };
+   mt19937 random (109);
+   uniform_real_distribution<float> xpos (0, width);
+   uniform_real_distribution<float> ypos (0, height);
+   uniform_int_distribution<int> channel (0, 255);
+   vector<object> scene;
+   for (size_t index = 0; index < count; ++index) {
+      scene.push_back (object (kinds[index % kinds.size()],
+                               vertex (xpos (random), ypos (random)),
+                               rgbcolor (channel (random),
+                                         channel (random),
+                                         channel (random))));
+   }
+   return scene;
+}
+
+template <typename func_t>
+double seconds (int reps, func_t func) {
+   auto start = chrono::steady_clock::now();
+   for (int rep = 0; rep < reps; ++rep) func();
+   chrono::duration<double> elapsed = chrono::steady_clock::now()
+                                    - start;
+   return elapsed.count() / reps;
+}
+
+volatile GLfloat sink;
+
+void report (const string& pass, const string& layout, double secs,
+             size_t count) {
+   cout << "layout " << setw (8) << pass << " " << setw (14) << layout
+        << " " << secs * 1e9 / count << " ns/object" << endl;
+}
+
+//
+// The passes the window makes over its objects: world bounds for
+// the spatial index, moving centers, and packing triangles into a
+// render list.
+//
+void bench_layout (const vector<object>& objects, int reps) {
+   scene_store store;
+   for (const auto& obj: objects) store.push_back (obj);
+   size_t count = objects.size();
+
+   report ("bounds", "vector<object>", seconds (reps, [&] {
+      bbox box;
+      for (const auto& obj: objects) box.expand (obj.bounds());
+      sink = box.right;
+   }), count);
+   report ("bounds", "scene_store", seconds (reps, [&] {
+      bbox box;
+      for (size_t slot = 0; slot < store.size(); ++slot) {
+         box.expand (store.bounds (slot));
+      }
+      sink = box.right;
+   }), count);
+
+   vector<object> moving = objects;
+   report ("move", "vector<object>", seconds (reps, [&] {
+      for (auto& obj: moving) obj.move (1, 1);
+   }), count);
+   report ("move", "scene_store", seconds (reps, [&] {
+      for (size_t slot = 0; slot < store.size(); ++slot) {
+         vertex center = store.center (slot);
+         store.set_center (slot, vertex (center.xpos + 1,
+                                         center.ypos + 1));
+      }
+   }), count);
+
+   vertex_list vertices;
+   vector<rgbcolor> colors;
+   vertex_list local;
+   report ("pack", "vector<object>", seconds (reps, [&] {
+      vertices.clear();
+      colors.clear();
+      for (const auto& obj: objects) {
+         local.clear();
+         if (not obj.get_shape().tessellate (local)) continue;
+         const vertex& center = obj.get_center();
+         for (const auto& vert: local) {
+            vertices.push_back (vertex (vert.xpos + center.xpos,
+                                        vert.ypos + center.ypos));
+         }
+         colors.insert (colors.end(), local.size(), obj.get_color());
+      }
+   }), count);
+   render_list batches;
+   report ("pack", "scene_store", seconds (reps, [&] {
+      batches.build (store);
+   }), count);
+}
+
+//
+// Whole frames drawn as one region, first by a plain raster_backend
+// and then by tiled backends on more and more threads.  Each tiled
+// image must match the plain one exactly.
+//
+void bench_tiles (const vector<object>& objects, int width, int height,
+                  int frames, size_t max_threads, int tile_size) {
+   scene_store store;
+   for (const auto& obj: objects) store.push_back (obj);
+   render_list list;
+   vector<size_t> visible (store.size());
+   for (size_t slot = 0; slot < visible.size(); ++slot) {
+      visible[slot] = slot;
+   }
+   bbox whole (0, 0, width, height);
+   auto draw = [&] (raster_backend& cpu) {
+      render::use (cpu);
+      return seconds (frames, [&] {
+         cpu.begin_frame (width, height);
+         cpu.draw_region (whole, store, list, visible);
+         cpu.end_frame();
+      });
+   };
+   framebuffer plain_image;
+   raster_backend plain (plain_image);
+   double plain_secs = draw (plain);
+   cout << "tiles   plain " << plain_secs * 1e3 << " ms/frame" << endl;
+   for (size_t threads = 1;; threads = min (threads * 2, max_threads)) {
+      framebuffer image;
+      tiled_backend cpu (image, threads, tile_size);
+      double secs = draw (cpu);
+      bool same = true;
+      for (int y = 0; y < height and same; ++y) {
+         same = equal (image.row (y), image.row (y) + width * 3,
+                       plain_image.row (y));
+      }
+      cout << "tiles " << setw (7) << threads << " " << secs * 1e3
+           << " ms/frame, " << plain_secs / secs << "x plain"
+           << (same ? "" : ", IMAGE DIFFERS") << endl;
+      if (not same) complain() << threads << " threads: image differs"
+                               << endl;
+      if (threads == max_threads) break;
+   }
+}
+
+int main (int argc, char** argv) {
+   sys_info::execname (argv[0]);
+   size_t count = 1000;
+   int width = 1024;
+   int height = 768;
+   int frames = 10;
+   size_t layout_count = 100000;
+   size_t max_threads = max (thread::hardware_concurrency(), 1u);
+   int tile_size = tiled_backend::default_tile_size;
+   opterr = 0;
+   for (;;) {
+      int option = getopt (argc, argv, "@:n:w:h:f:N:j:t:");
+      if (option == EOF) break;
+      switch (option) {
+         case '@': debugflags::setflags (optarg); break;
+         case 'n': count = stoul (optarg); break;
+         case 'w': width = stoi (optarg); break;
+         case 'h': height = stoi (optarg); break;
+         case 'f': frames = stoi (optarg); break;
+         case 'N': layout_count = stoul (optarg); break;
+         case 'j': max_threads = max (stoul (optarg), 1ul); break;
+         case 't': tile_size = stoi (optarg); break;
+         default:
+            complain() << "-" << char (optopt) << ": invalid option"
+                       << endl;
+            break;
+      }
+   }
+   if (sys_info::exit_status() != 0) return sys_info::exit_status();
+
+   vector<object> scene = make_scene (count, width, height);
+   framebuffer image;
+   raster_backend cpu (image);
+   render::use (cpu);
+   auto start = chrono::steady_clock::now();
+   for (int frame = 0; frame < frames; ++frame) {
+      cpu.begin_frame (width, height);
+      cpu.clear_region (bbox (0, 0, width, height));
+      for (auto& obj: scene) obj.draw();
+      cpu.end_frame();
+   }
+   chrono::duration<double> elapsed = chrono::steady_clock::now()
+                                    - start;
+   double shapes = double (count) * frames;
+   double pixels = cpu.stats().pixels;
+   cout << "raster " << width << "x" << height << ", " << count
+        << " shapes, " << frames << " frames, "
+        << elapsed.count() << " sec" << endl;
+   cout << "shapes/sec " << shapes / elapsed.count() << endl;
+   cout << "pixels/sec " << pixels / elapsed.count() << endl;
+
+   bench_layout (make_scene (layout_count, width, height), 5);
+   bench_tiles (scene, width, height, frames, max_threads, tile_size);
+   return sys_info::exit_status();
+}
+
@@ -0,0 +1,43 @@
+// $Id$
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+#include "damage.h"
+#include "debug.h"
+#include "util.h"
+
+void damage_region::add (const bbox& box, int width, int height) {
+   if (box.empty()) return;
+   bbox pixels {max (floor (box.left), 0.0f),
+                max (floor (box.bottom), 0.0f),
+                min (ceil (box.right), GLfloat (width)),
+                min (ceil (box.top), GLfloat (height))};
+   if (pixels.left >= pixels.right or pixels.bottom >= pixels.top) {
+      return;
+   }
+   for (size_t index = 0; index < rects.size(); ) {
+      if (rects[index].intersects (pixels)) {
+         pixels.expand (rects[index]);
+         rects.erase (rects.begin() + index);
+         index = 0;
+      }else {
+         ++index;
+      }
+   }
+   rects.push_back (pixels);
+   if (rects.size() > max_rects) {
+      for (const auto& rect: rects) pixels.expand (rect);
+      rects.assign (1, pixels);
+   }
+   DEBUGF ('r', "(" << pixels.left << "," << pixels.bottom << ")-("
+           << pixels.right << "," << pixels.top << "), "
+           << rects.size() << " rects");
+}
+
+void damage_region::add_all (int width, int height) {
+   rects.assign (1, bbox (0, 0, width, height));
+}
+
@@ -0,0 +1,38 @@
+// $Id$
+
+#ifndef __DAMAGE_H__
+#define __DAMAGE_H__
+
+#include <vector>
+using namespace std;
+
+#include "shape.h"
+
+//
+// damage_region -
+//    Accumulates the window rectangles that must be re-rendered
+//    before the next frame is presented.
+// add -
+//    Snap a box outward to whole pixels, clip it to the window and
+//    merge it with any rectangle it overlaps.  Once there are more
+//    than max_rects disjoint rectangles they collapse into their
+//    union, since past that point per-rectangle overhead costs more
+//    than the extra fill.
+// add_all -
+//    Damage the whole window.
+//
+
+class damage_region {
+   private:
+      static const size_t max_rects = 8;
+      vector<bbox> rects;
+   public:
+      void add (const bbox& box, int width, int height);
+      void add_all (int width, int height);
+      bool empty() const { return rects.empty(); }
+      const vector<bbox>& regions() const { return rects; }
+      void clear() { rects.clear(); }
+};
+
+#endif
+
@@ -0,0 +1,132 @@
+// $Id$
+
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+using namespace std;
+
+#include "frames.h"
+#include "trace.h"
+#include "util.h"
+
+frame_writer::frame_writer (size_t threads):
+              max_pending (2 * max<size_t> (threads, 1)) {
+   for (size_t count = 0; count < max<size_t> (threads, 1); ++count) {
+      workers.emplace_back (&frame_writer::work, this);
+   }
+}
+
+//
+// Each worker takes the oldest frame, encodes and writes it with the
+// lock released, then puts its framebuffer back for acquire.  errno
+// belongs to the thread, so the reason for a failure is kept as text
+// for finish to report.
+//
+void frame_writer::work() {
+   unique_lock<mutex> guard (lock);
+   for (;;) {
+      ready.wait (guard, [this] { return done or not pending.empty(); });
+      if (pending.empty()) return;
+      job next = move (pending.front());
+      pending.pop_front();
+      room.notify_one();
+      guard.unlock();
+      string error;
+      {
+         TRACE_SCOPE ('g', "write frame", next.image.height());
+         ofstream outfile (next.filename, ios::binary);
+         bool png = next.filename.size() >= 4
+                    and next.filename.compare (next.filename.size() - 4,
+                                               4, ".png") == 0;
+         if (outfile.fail()) {
+            error = strerror (errno);
+         }else if (png and not next.image.write_png (outfile)) {
+            error = "PNG encoding failed";
+         }else {
+            if (not png) next.image.write_ppm (outfile);
+            outfile.close();
+            if (outfile.fail()) error = strerror (errno);
+         }
+      }
+      guard.lock();
+      if (error.size() != 0) {
+         errors.push_back (next.filename + ": " + error);
+      }else {
+         ++written;
+      }
+      spare.push_back (move (next.image));
+   }
+}
+
+framebuffer frame_writer::acquire() {
+   lock_guard<mutex> guard (lock);
+   if (spare.empty()) return framebuffer();
+   framebuffer image = move (spare.back());
+   spare.pop_back();
+   return image;
+}
+
+void frame_writer::submit (framebuffer&& image, const string& filename) {
+   unique_lock<mutex> guard (lock);
+   room.wait (guard, [this] { return pending.size() < max_pending; });
+   pending.push_back ({move (image), filename});
+   ready.notify_one();
+}
+
+size_t frame_writer::finish() {
+   {
+      lock_guard<mutex> guard (lock);
+      done = true;
+   }
+   ready.notify_all();
+   for (thread& worker: workers) worker.join();
+   workers.clear();
+   for (const string& error: errors) complain() << error << endl;
+   errors.clear();
+   return written;
+}
+
+//
+// The conversion is found by hand rather than handing the pattern to
+// printf, so a stray % elsewhere in a file name is harmless.
+//
+static size_t find_conversion (const string& pattern, size_t& end,
+                               bool& zero, int& width) {
+   for (size_t start = pattern.find ('%'); start != string::npos;
+        start = pattern.find ('%', start + 1)) {
+      size_t next = start + 1;
+      zero = next < pattern.size() and pattern[next] == '0';
+      if (zero) ++next;
+      width = 0;
+      while (next < pattern.size() and isdigit (pattern[next])) {
+         width = width * 10 + pattern[next++] - '0';
+      }
+      if (next < pattern.size() and pattern[next] == 'd') {
+         end = next + 1;
+         return start;
+      }
+   }
+   return string::npos;
+}
+
+bool frame_pattern (const string& pattern) {
+   size_t end;
+   bool zero;
+   int width;
+   return find_conversion (pattern, end, zero, width) != string::npos;
+}
+
+string frame_name (const string& pattern, int frame) {
+   size_t end;
+   bool zero;
+   int width;
+   size_t start = find_conversion (pattern, end, zero, width);
+   if (start == string::npos) return pattern;
+   string number = to_string (frame);
+   if (int (number.size()) < width) {
+      number.insert (0, width - number.size(), zero ? '0' : ' ');
+   }
+   return pattern.substr (0, start) + number + pattern.substr (end);
+}
+
@@ -0,0 +1,72 @@
+// $Id$
+
+#ifndef __FRAMES_H__
+#define __FRAMES_H__
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#include "raster.h"
+
+//
+// frame_writer -
+//    Writes rendered frames to files on worker threads, so encoding
+//    and writing one frame overlaps rasterizing the next.  A file is
+//    PNG if its name ends in .png, and PPM otherwise.
+// acquire -
+//    A framebuffer to render the next frame into, reusing one that
+//    has been written if there is one.
+// submit -
+//    Queue a frame for writing.  At most max_pending frames wait, and
+//    past that submit blocks, so a slow disk holds back the renderer
+//    rather than filling memory.
+// finish -
+//    Wait for every frame to be written and stop the workers.  Errors
+//    from the workers are reported here, on the calling thread.
+//    Returns the number of frames written.
+//
+// frame_pattern -
+//    Whether a pattern has a %d conversion for the frame number.
+// frame_name -
+//    The file for frame number frame, from a pattern with one printf
+//    style %d conversion, which may have a zero flag and a width.
+//    Without one, the pattern is used as is.
+//
+
+class frame_writer {
+   private:
+      struct job {
+         framebuffer image;
+         string filename;
+      };
+      size_t max_pending;
+      vector<thread> workers;
+      deque<job> pending;
+      vector<framebuffer> spare;
+      vector<string> errors;
+      size_t written {0};
+      bool done {false};
+      mutex lock;
+      condition_variable ready;     // pending nonempty, or done
+      condition_variable room;      // pending below max_pending
+      void work();
+   public:
+      explicit frame_writer (size_t threads);
+      ~frame_writer() { finish(); }
+      frame_writer (const frame_writer&) = delete;
+      frame_writer& operator= (const frame_writer&) = delete;
+      framebuffer acquire();
+      void submit (framebuffer&& image, const string& filename);
+      size_t finish();
+};
+
+bool frame_pattern (const string& pattern);
+string frame_name (const string& pattern, int frame);
+
+#endif
+
@@ -0,0 +1,162 @@
+// $Id$
+
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <unordered_map>
+using namespace std;
+
+#include "debug.h"
+#include "glyph.h"
+#include "trace.h"
+#include "util.h"
+
+//
+// Whether a font table has the layout glyph.h expects: an X font
+// name, a code for every byte, and sane sizes.  With GLUT running,
+// the public queries must give the same height and widths.
+//
+static bool font_matches (const freeglut_font* font,
+                          void* glut_bitmap_font) {
+   if (font == nullptr or font->name == nullptr or font->name[0] != '-'
+       or font->quantity != 256 or font->characters == nullptr
+       or font->height <= 0 or font->height > 64
+       or font->yorig < 0 or font->yorig >= font->height) {
+      return false;
+   }
+   bool running = glutGet (GLUT_INIT_STATE);
+   if (running and glutBitmapHeight (glut_bitmap_font) != font->height) {
+      return false;
+   }
+   for (int code = 0; code < font->quantity; ++code) {
+      const GLubyte* bitmap = font->characters[code];
+      if (bitmap == nullptr or bitmap[0] > 2 * font->height) return false;
+      if (running and code != 0
+          and glutBitmapWidth (glut_bitmap_font, code) != bitmap[0]) {
+         return false;
+      }
+   }
+   return true;
+}
+
+//
+// Runs are found a row at a time from the packed bits, and the same
+// bits are unpacked into the atlas, so both backends draw exactly
+// the pixels glBitmap would.
+//
+static glyph_atlas unpack (void* glut_bitmap_font) {
+   glyph_atlas atlas;
+   const freeglut_font* font = fghFontByID (glut_bitmap_font);
+   if (not font_matches (font, glut_bitmap_font)) {
+      complain() << "freeglut font table " << glut_bitmap_font
+                 << " is not laid out as expected; its text is not"
+                 << " drawn" << endl;
+      return atlas;
+   }
+   atlas.glut_bitmap_font = glut_bitmap_font;
+   atlas.height = font->height;
+   atlas.xorig = int (font->xorig);
+   atlas.yorig = int (font->yorig);
+   atlas.glyphs.resize (font->quantity);
+   for (int code = 0; code < font->quantity; ++code) {
+      glyph& each = atlas.glyphs[code];
+      each.width = font->characters[code][0];
+      each.xpos = atlas.width;
+      atlas.width += each.width;
+   }
+   atlas.pixels.resize (size_t (atlas.width) * atlas.height);
+   for (int code = 0; code < font->quantity; ++code) {
+      glyph& each = atlas.glyphs[code];
+      const GLubyte* bitmap = font->characters[code];
+      int stride = (each.width + 7) / 8;
+      each.first_run = atlas.runs.size();
+      for (int row = 0; row < atlas.height; ++row) {
+         const GLubyte* bits = bitmap + 1 + row * stride;
+         GLubyte* line = &atlas.pixels[size_t (row) * atlas.width
+                                       + each.xpos];
+         int start = -1;
+         for (int col = 0; col <= each.width; ++col) {
+            bool set = col < each.width
+                       and (bits[col / 8] & (0x80 >> (col % 8)));
+            if (set) line[col] = 255;
+            if (set and start < 0) start = col;
+            if (not set and start >= 0) {
+               atlas.runs.push_back ({int16_t (row), int16_t (start),
+                                      int16_t (col)});
+               start = -1;
+            }
+         }
+      }
+      each.run_count = atlas.runs.size() - each.first_run;
+   }
+   DEBUGF ('t', font->name << ": " << atlas.width << "x"
+           << atlas.height << ", " << atlas.runs.size() << " runs");
+   return atlas;
+}
+
+const glyph_atlas* glyph_cache::atlas (void* glut_bitmap_font) {
+   static const unordered_map<void*,glyph_atlas> atlases = [] {
+      TRACE_SCOPE ('t', "glyph atlases", 0);
+      unordered_map<void*,glyph_atlas> fonts;
+      if (fghFontByID == nullptr) {
+         complain() << "freeglut has no fghFontByID; text is not drawn"
+                    << endl;
+         return fonts;
+      }
+      for (void* font: {GLUT_BITMAP_8_BY_13, GLUT_BITMAP_9_BY_15,
+                        GLUT_BITMAP_HELVETICA_10, GLUT_BITMAP_HELVETICA_12,
+                        GLUT_BITMAP_HELVETICA_18,
+                        GLUT_BITMAP_TIMES_ROMAN_10,
+                        GLUT_BITMAP_TIMES_ROMAN_24}) {
+         fonts.emplace (font, unpack (font));
+      }
+      return fonts;
+   }();
+   auto itor = atlases.find (glut_bitmap_font);
+   if (itor == atlases.end()) return nullptr;
+   return &itor->second;
+}
+
+text_layout glyph_cache::layout (void* glut_bitmap_font,
+                                 const string& textdata) {
+   text_layout layout;
+   layout.atlas = atlas (glut_bitmap_font);
+   if (layout.atlas == nullptr) return layout;
+   const glyph_atlas& font = *layout.atlas;
+   int xpos = 0;
+   int ypos = 0;
+   int left = INT_MAX;
+   int bottom = INT_MAX;
+   int right = INT_MIN;
+   int top = INT_MIN;
+   for (unsigned char code: textdata) {
+      if (code == '\n') {
+         xpos = 0;
+         ypos -= font.height;
+         continue;
+      }
+      if (code >= font.glyphs.size()) continue;
+      const glyph& each = font.glyphs[code];
+      int xglyph = xpos - font.xorig;
+      int yglyph = ypos - font.yorig;
+      xpos += each.width;
+      if (each.run_count == 0) continue;
+      layout.glyphs.push_back ({int16_t (xglyph), int16_t (yglyph),
+                                code});
+      for (uint32_t run = 0; run < each.run_count; ++run) {
+         const glyph_run& ink = font.runs[each.first_run + run];
+         left = min (left, xglyph + ink.x0);
+         right = max (right, xglyph + ink.x1);
+         bottom = min (bottom, yglyph + ink.y);
+         top = max (top, yglyph + ink.y + 1);
+      }
+   }
+   if (not layout.glyphs.empty()) {
+      layout.left = left - 1;
+      layout.bottom = bottom - 1;
+      layout.right = right + 1;
+      layout.top = top + 1;
+   }
+   return layout;
+}
+
@@ -0,0 +1,126 @@
+// $Id$
+
+#ifndef __GLYPH_H__
+#define __GLYPH_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <GL/freeglut.h>
+
+//
+// freeglut_font -
+//    freeglut exports the tables behind the GLUT_BITMAP_* fonts along
+//    with its lookup function, and neither needs glutInit.  Each
+//    character is a width byte followed by height rows of packed
+//    bits, bottom row first, exactly what glutBitmapCharacter hands
+//    to glBitmap.  The advance is the width.  This is freeglut's
+//    private SFG_Font, unchanged from 2.0 through 3.4; nothing but
+//    freeglut builds.  The lookup is declared weak, so a freeglut
+//    that hides it still links, and each table is checked before it
+//    is unpacked: a missing lookup, or a table that does not look
+//    like a font, or that disagrees with glutBitmapHeight and
+//    glutBitmapWidth once GLUT is initialized, is reported once and
+//    leaves that font's text undrawn rather than drawing garbage.
+//
+
+#if not defined (FREEGLUT) or not defined (FREEGLUT_VERSION_2_0)
+#error "glyph atlases read freeglut's font tables; need freeglut 2.0+"
+#endif
+
+struct freeglut_font {
+   const char* name;
+   int quantity;
+   int height;
+   const GLubyte** characters;
+   float xorig;
+   float yorig;
+};
+
+extern "C" freeglut_font* fghFontByID (void* font)
+           __attribute__ ((weak));
+
+//
+// glyph_atlas -
+//    One bitmap font, unpacked once.  Every glyph is placed side by
+//    side in pixels, one byte per pixel, 0 or 255, bottom row first,
+//    for the GL backend to upload as a texture.  Each glyph also has
+//    its set pixels as runs along its rows, relative to its bottom
+//    left corner, for the raster backend to fill as spans.
+// glyph -
+//    width is both the glyph's width in the atlas and its advance.
+//    xpos is its first column in the atlas.
+//
+
+struct glyph_run {
+   int16_t y;
+   int16_t x0;
+   int16_t x1;
+};
+
+struct glyph {
+   int16_t width {0};
+   int16_t xpos {0};
+   uint32_t first_run {0};
+   uint32_t run_count {0};
+};
+
+struct glyph_atlas {
+   void* glut_bitmap_font {nullptr};
+   int height {0};
+   int xorig {0};
+   int yorig {0};
+   vector<glyph> glyphs;        // by character code
+   vector<glyph_run> runs;
+   int width {0};
+   vector<GLubyte> pixels;      // width by height
+   mutable GLuint texture {0};  // made by the GL backend
+};
+
+//
+// text_layout -
+//    A string set in one font: the bottom left corner of every glyph
+//    that has ink, relative to the truncated origin, and the box
+//    around that ink padded by a pixel, as text is drawn from an
+//    integer origin.  Lines are separated by newlines and go down by
+//    the font height.  A string with no ink has a two pixel box
+//    around the origin.
+//
+
+struct placed_glyph {
+   int16_t xpos;
+   int16_t ypos;
+   uint8_t code;
+};
+
+struct text_layout {
+   const glyph_atlas* atlas {nullptr};
+   vector<placed_glyph> glyphs;
+   int left {-1};
+   int bottom {-1};
+   int right {1};
+   int top {1};
+};
+
+//
+// glyph_cache -
+//    Static class holding an atlas for each of the GLUT bitmap fonts,
+//    all unpacked together on first use.
+// atlas -
+//    The atlas for a GLUT font handle, or nullptr if it is not one.
+// layout -
+//    Set a string.  Characters outside the font are skipped.
+//
+
+class glyph_cache {
+   public:
+      glyph_cache() = delete;
+      static const glyph_atlas* atlas (void* glut_bitmap_font);
+      static text_layout layout (void* glut_bitmap_font,
+                                 const string& textdata);
+};
+
+#endif
+
@@ -1,18 +1,43 @@
 // $Id: graphics.cpp,v 1.4 2016/07/30 22:27:52 akhatri Exp $
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <thread>
 using namespace std;
 
 #include <GL/freeglut.h>
 
+#include "animate.h"
+#include "frames.h"
 #include "graphics.h"
+#include "profile.h"
+#include "raster.h"
+#include "render.h"
+#include "trace.h"
 #include "util.h"
 
 int window::width = 640; // in pixels
 int window::height = 480; // in pixels
-vector<object> window::objects;
+size_t window::threads = 0;
+scene_store window::objects;
+render_list window::batches;
+bool window::batches_stale = true;
+damage_region window::damaged;
+spatial_grid window::index;
+vector<size_t> window::visible;
+vector<size_t> window::drawn;
 size_t window::selected_obj = 0;
+bool window::ticking = false;
 mouse window::mus;
+bbox window::profile_box;
+vector<bbox> window::moved_from;
+input_queue window::input;
+vector<input_event> window::input_events;
+vector<input_queue::clock::time_point> window::input_stamps;
+vertex window::pending_move (0.0f, 0.0f);
+vector<void (*)()> window::closers;
 
 void object::draw_border() { 
    pshape->border(center, border_width, border_color);
@@ -27,20 +52,26 @@ void object::set_move(float x) {
    move_by = x;
       }
 
-void object::move (const string & str){
+// Step for a move in the named direction.
+static vertex move_step (const string & str, float move_by) {
    if(str == "up") {
-      center.ypos += move_by;
+      return vertex(0.0f, move_by);
    }
    else if(str == "down") {
-      center.ypos -= move_by;
+      return vertex(0.0f, -move_by);
    }
    else if(str == "left") {
-      center.xpos -= move_by;
+      return vertex(-move_by, 0.0f);
    }
    else if(str == "right") {
-      center.xpos += move_by;
+      return vertex(move_by, 0.0f);
    }
-   move(0, 0);
+   return vertex(0.0f, 0.0f);
+}
+
+void object::move (const string & str){
+   vertex step = move_step (str, move_by);
+   move(step.xpos, step.ypos);
 }
 
 void object::set_border(float width, rgbcolor color) {
@@ -50,82 +81,495 @@ void object::set_border(float width, rgbcolor color) {
       border_color = color;
 }
 
+void object_ref::draw() {
+   window::objects.draw (slot);
+}
+
+void object_ref::draw_border() {
+   window::objects.draw_border (slot);
+}
+
+void object_ref::move (GLfloat delta_x, GLfloat delta_y) {
+   bbox from = window::extent (slot);
+   vertex center = window::objects.center (slot);
+   window::objects.set_center (slot, vertex (center.xpos + delta_x,
+                                             center.ypos + delta_y));
+   window::moved (slot, from);
+}
+
+void object_ref::set_move (float x) {
+   window::objects.set_move_by (slot, x);
+}
+
+void object_ref::move (const string & str) {
+   vertex step = move_step (str, window::objects.move_by (slot));
+   move (step.xpos, step.ypos);
+}
+
+void object_ref::set_border (float width, rgbcolor color) {
+   if (width <= 0.0) width = window::objects.border_width (slot);
+   window::objects.set_border (slot, width, color);
+}
+
+void object_ref::set_rotation (float degrees) {
+   bbox from = window::extent (slot);
+   window::objects.set_transform (slot, degrees * M_PI / 180,
+                                  window::objects.xscales()[slot],
+                                  window::objects.yscales()[slot]);
+   window::transformed (slot, from);
+}
+
+void object_ref::set_scale (float xscale, float yscale) {
+   bbox from = window::extent (slot);
+   window::objects.set_transform (slot, window::objects.angles()[slot],
+                                  xscale, yscale);
+   window::transformed (slot, from);
+}
+
+vertex object_ref::get_center() const {
+   return window::objects.center (slot);
+}
+
+const rgbcolor& object_ref::get_color() const {
+   return window::objects.color (slot);
+}
+
+bbox object_ref::bounds() const {
+   return window::objects.bounds (slot);
+}
+
 
 // Executed when window system signals to shut down.
 void window::close() {
+   for (auto closer: closers) closer();
    DEBUGF ('g', sys_info::execname() << ": exit ("
            << sys_info::exit_status() << ")");
+   profiler::report (cerr);
    exit (sys_info::exit_status());
 }
 
 // Executed when mouse enters or leaves window.
 void window::entry (int mouse_entered) {
    DEBUGF ('g', "mouse_entered=" << mouse_entered);
+   queue_input ({input_event::kind::entry, 0, mouse_entered, 0, 0});
+}
+
+void window::handle_entry (int mouse_entered) {
+   mouse before = window::mus;
    window::mus.entered = mouse_entered;
    if (window::mus.entered == GLUT_ENTERED) {
       DEBUGF ('g', sys_info::execname() << ": width=" << window::width
            << ", height=" << window::height);
    }
-   glutPostRedisplay();
+   post_mouse (before);
+}
+
+void window::push_back (const object& obj) {
+   size_t slot = objects.push_back (obj);
+   bbox box = objects.bounds (slot);
+   index.insert (slot, box);
+   batches_stale = true;
+   damaged.add (box, window::width, window::height);
+}
+
+void window::append (const vector<shape_ptr>& shapes,
+                     const scene_columns& columns) {
+   size_t first = objects.append (shapes, columns);
+   vector<bbox> boxes;
+   boxes.reserve (columns.count);
+   for (size_t slot = first; slot < objects.size(); ++slot) {
+      boxes.push_back (objects.bounds (slot));
+   }
+   index.insert (first, boxes);
+   batches_stale = true;
+}
+
+// Called when a reloaded script changes an object already in the
+// window.  Its rotation and scale are reset, as in a new object.
+// Like transformed, this and truncate only record the damage, and
+// the caller asks GLUT for the redisplay.
+void window::assign (size_t slot, const object& obj) {
+   TRACE ('g', "assign", slot);
+   damaged.add (extent (slot), window::width, window::height);
+   objects.assign (slot, obj);
+   batches_stale = true;
+   index.update (slot, objects.bounds (slot));
+   damaged.add (extent (slot), window::width, window::height);
+}
+
+// Called when a reloaded script draws fewer objects.  The index is
+// built again in bulk.
+void window::truncate (size_t count) {
+   if (count >= objects.size()) return;
+   TRACE ('g', "truncate", count);
+   for (size_t slot = count; slot < objects.size(); ++slot) {
+      damaged.add (extent (slot), window::width, window::height);
+   }
+   objects.truncate (count);
+   batches_stale = true;
+   if (selected_obj >= count) selected_obj = 0;
+   vector<bbox> boxes;
+   boxes.reserve (count);
+   for (size_t slot = 0; slot < count; ++slot) {
+      boxes.push_back (objects.bounds (slot));
+   }
+   index.clear();
+   index.insert (0, boxes);
+}
+
+// Redraw the given regions through the current render backend, from
+// the retained render list.  The list is only rebuilt after objects
+// were added; moves patch it in place.  Only objects the spatial
+// index finds in a region are submitted.  With overlay, the selected
+// object's border, the mouse and the profile are drawn on top.
+void window::render_regions (const vector<bbox>& regions,
+                             bool overlay) {
+   TRACE_SCOPE ('g', "render_regions", regions.size());
+   render_backend& backend = render::backend();
+   if (batches_stale and not backend.draws_instances()) {
+      batches.build (window::objects);
+      batches_stale = false;
+   }
+   profiler::begin_frame();
+   backend.begin_frame (window::width, window::height);
+   vector<string> profile;
+   if (overlay and profiler::overlay_visible()) {
+      profile = profiler::overlay();
+   }
+   bool counted = profiler::enabled();
+   drawn.clear();
+   for (const auto& region: regions) {
+      visible.clear();
+      index.query (region, visible);
+      if (counted) drawn.insert (drawn.end(), visible.begin(), visible.end());
+      backend.draw_region (region, window::objects, batches, visible);
+      if (overlay) {
+         if (selected_obj < objects.size()) {
+            objects.draw_border (selected_obj);
+         }
+         mus.draw();
+         draw_profile (profile);
+      }
+   }
+   backend.end_frame();
+   if (counted) {
+      sort (drawn.begin(), drawn.end());
+      drawn.erase (unique (drawn.begin(), drawn.end()), drawn.end());
+      for (size_t slot: drawn) {
+         profiler::add_objects (objects.geometry_of (slot).class_id, 1,
+                                objects.vertex_count (slot));
+      }
+   }
+   profiler::end_frame();
+}
+
+// Redraw the whole window, without the overlay.
+void window::render_frame() {
+   render_regions ({bbox (0, 0, window::width, window::height)}, false);
+}
+
+// Called by object_ref::move when an object in the window has moved.
+void window::moved (size_t slot, const bbox& from) {
+   TRACE ('g', "moved", slot);
+   if (not batches_stale) batches.move (slot, objects.center (slot));
+   index.update (slot, objects.bounds (slot));
+   post (from);
+   post (extent (slot));
+}
+
+// Box around everything drawn for slot, including the border when
+// it is the selected object.
+bbox window::extent (size_t slot) {
+   bbox box = objects.bounds (slot);
+   if (slot == selected_obj) box.expand (objects.border_bounds (slot));
+   return box;
+}
+
+// Called by object_ref when an object has been rotated or scaled.
+// Its vertices in the render list all change, so the list is built
+// again.  Like animate, this asks nothing of GLUT, since scripts
+// rotate and scale objects before there is a window.
+void window::transformed (size_t slot, const bbox& from) {
+   TRACE ('g', "transformed", slot);
+   batches_stale = true;
+   index.update (slot, objects.bounds (slot));
+   damaged.add (from, window::width, window::height);
+   damaged.add (extent (slot), window::width, window::height);
+}
+
+// Run the animation for seconds, then bring the spatial index, the
+// render list and the damage up to date for every object it moved.
+// Past a few dozen moving objects the whole window is damaged
+// instead of each object's old and new box, and once an eighth of
+// the objects move the spatial index is rebuilt in bulk instead of
+// updated slot by slot.  Nothing is asked of GLUT, so this also
+// works headless.
+void window::animate (double seconds) {
+   static const size_t max_boxes = 64;
+   const vector<size_t>& moving = animation::moving();
+   bool whole = moving.size() > max_boxes;
+   moved_from.clear();
+   if (not whole) {
+      for (size_t slot: moving) {
+         moved_from.push_back (extent (slot));
+      }
+   }
+   if (animation::advance (objects, seconds) == 0) return;
+   bool rebuild = moving.size() * 8 > objects.size();
+   if (rebuild) {
+      vector<bbox> boxes;
+      boxes.reserve (objects.size());
+      for (size_t slot = 0; slot < objects.size(); ++slot) {
+         boxes.push_back (objects.bounds (slot));
+      }
+      index.clear();
+      index.insert (0, boxes);
+   }
+   for (size_t moved = 0; moved < moving.size(); ++moved) {
+      size_t slot = moving[moved];
+      bbox box = objects.bounds (slot);
+      if (not rebuild) index.update (slot, box);
+      if (not batches_stale) batches.move (slot, objects.center (slot));
+      if (not whole) {
+         damaged.add (moved_from[moved], window::width, window::height);
+         damaged.add (extent (slot), window::width, window::height);
+      }
+   }
+   if (whole) damaged.add_all (window::width, window::height);
+}
+
+// Timer callback while anything is animated: advance by the real
+// time since the last tick and redisplay if anything moved.  It
+// stops when nothing is animated any more.
+void window::tick (int) {
+   using clock = chrono::steady_clock;
+   static clock::time_point last = clock::now();
+   clock::time_point now = clock::now();
+   chrono::duration<double> elapsed = now - last;
+   last = now;
+   animate (elapsed.count());
+   if (not damaged.empty()) glutPostRedisplay();
+   ticking = animation::active();
+   if (ticking) {
+      glutTimerFunc (unsigned (animation::step_seconds * 1000), tick, 0);
+   }
 }
 
-// Called to display the objects in the window.
+// Start the timer, if anything is animated and it is not running.
+// Called once the window is open, and after a script reload.
+void window::start_animation() {
+   if (ticking or not animation::active()) return;
+   ticking = true;
+   glutTimerFunc (0, window::tick, 0);
+}
+
+// Damage part of the window.  Only input handlers post, and they
+// run at the start of display, so the damage is drawn in that frame.
+void window::post (const bbox& box) {
+   damaged.add (box, window::width, window::height);
+}
+
+// Damage the mouse overlay, if what it shows has changed.
+void window::post_mouse (const mouse& before) {
+   if (before.visible() == mus.visible()
+       and (not mus.visible() or before.label() == mus.label())) {
+      return;
+   }
+   if (before.visible()) post (before.bounds());
+   if (mus.visible()) post (mus.bounds());
+}
+
+// Called to display the objects in the window.  Only damaged regions
+// are redrawn.  With no damage, as after an expose, the retained
+// frame is just presented again.  The profile overlay, if shown, is
+// redrawn with every frame that draws anything, showing the frame
+// before; it never asks for a frame itself.  Queued input is
+// handled first, and the time from each event's arrival to the end
+// of the frame goes to the profiler.
 void window::display() {
-   glClear (GL_COLOR_BUFFER_BIT);
-   for (auto& object: window::objects) object.draw();
-   mus.draw();
-   glutSwapBuffers();
+   handle_input();
+   if (not damaged.empty() and profiler::overlay_visible()) {
+      damaged.add (profile_box, window::width, window::height);
+      profile_box = profile_bounds (profiler::overlay());
+      damaged.add (profile_box, window::width, window::height);
+   }
+   render_regions (damaged.regions(), true);
+   damaged.clear();
+   if (input_stamps.empty()) return;
+   input_queue::clock::time_point shown = input_queue::clock::now();
+   for (const auto& stamp: input_stamps) {
+      chrono::duration<double> latency = shown - stamp;
+      profiler::add_latency (latency.count());
+   }
+   input_stamps.clear();
+}
+
+// Run the animation for seconds of its time, as fast as it can, in
+// the largest steps animate takes at once.
+void window::fast_forward (double seconds) {
+   const double chunk = animation::max_steps * animation::step_seconds;
+   for (double left = seconds; left > 0; left -= chunk) {
+      animate (min (left, chunk));
+   }
+}
+
+// Render frames on the CPU and write them, no GLUT needed.  The first
+// frame is drawn whole; after that only the damage from animating is
+// redrawn, into the same image, which is then copied to a buffer the
+// writer threads own while the next frame is drawn.  Regions are
+// drawn as tiles on every core, or on as many threads as were set.
+void window::headless (const string& pattern, int frames,
+                       double frame_seconds) {
+   TRACE_SCOPE ('g', "headless", objects.size());
+   framebuffer image;
+   tiled_backend cpu (image, threads != 0 ? threads
+                             : thread::hardware_concurrency());
+   render_backend& previous = render::backend();
+   render::use (cpu);
+   frame_writer writer (min (thread::hardware_concurrency(), 4u));
+   for (int frame = 0; frame < frames; ++frame) {
+      if (frame == 0) {
+         render_frame();
+      }else {
+         fast_forward (frame_seconds);
+         if (not damaged.empty()) render_regions (damaged.regions(), false);
+      }
+      damaged.clear();
+      framebuffer copy = writer.acquire();
+      copy = image;
+      writer.submit (move (copy), frame_name (pattern, frame));
+   }
+   render::use (previous);
+   size_t written = writer.finish();
+   profiler::report (cerr);
+   DEBUGF ('g', pattern << ": " << written << " frames, "
+           << cpu.stats().primitives << " primitives, "
+           << cpu.stats().pixels << " pixels");
 }
 
 // Called when window is opened and when resized.
 void window::reshape (int width, int height) {
    DEBUGF ('g', "width=" << width << ", height=" << height);
+   TRACE ('g', "reshape", width);
    window::width = width;
    window::height = height;
+   mus.relabel();
    glMatrixMode (GL_PROJECTION);
    glLoadIdentity();
    gluOrtho2D (0, window::width, 0, window::height);
    glMatrixMode (GL_MODELVIEW);
    glViewport (0, 0, window::width, window::height);
    glClearColor (0.25, 0.25, 0.25, 1.0);
+   damaged.add_all (window::width, window::height);
    glutPostRedisplay();
 }
 
 
+// Every input callback queues its event and asks for a redisplay,
+// which handles whatever has come in since the last one.  Under key
+// repeat on a busy scene, many events are then drawn in one frame.
+void window::queue_input (const input_event& event) {
+   input.push (event);
+   glutPostRedisplay();
+}
+
+// Handle the queued input in order.  Moves of the selected object
+// add up in pending_move and are applied as one.
+void window::handle_input() {
+   input.take (input_events, input_stamps);
+   if (input_events.empty()) return;
+   TRACE_SCOPE ('g', "handle_input", input_events.size());
+   for (const auto& event: input_events) {
+      switch (event.what) {
+         case input_event::kind::key:
+            handle_key (event.key, event.x, event.y);
+            break;
+         case input_event::kind::special:
+            handle_special (event.key, event.x, event.y);
+            break;
+         case input_event::kind::motion:
+            handle_motion (event.x, event.y);
+            break;
+         case input_event::kind::button:
+            handle_button (event.key, event.state, event.x, event.y);
+            break;
+         case input_event::kind::entry:
+            handle_entry (event.state);
+            break;
+      }
+   }
+   flush_move();
+}
+
+// Move the selected object by the moves added up since the last
+// flush, so its render list entry, index and damage are updated
+// once for however many keys asked for it.
+void window::flush_move() {
+   if (pending_move.xpos == 0 and pending_move.ypos == 0) return;
+   if (selected_obj < objects.size()) {
+      get_selected().move (pending_move.xpos, pending_move.ypos);
+   }
+   pending_move = vertex (0.0f, 0.0f);
+}
+
 // Executed when a regular keyboard key is pressed.
 void window::keyboard (GLubyte key, int x, int y) {
-   enum {BS = 8, TAB = 9, ESC = 27, SPACE = 32, DEL = 127};
    DEBUGF ('g', "key=" << unsigned (key) << ", x=" << x << ", y=" << y);
+   TRACE ('g', "keyboard", key);
+   queue_input ({input_event::kind::key, key, 0, x, y});
+}
+
+void window::handle_key (GLubyte key, int x, int y) {
+   enum {BS = 8, TAB = 9, ESC = 27, SPACE = 32, DEL = 127};
+   mouse before = window::mus;
    window::mus.set (x, y);
-  auto & obj = window::objects[selected_obj];
+   const char* direction = nullptr;
+   switch (key) {
+      case 'H': case 'h': direction = "left"; break;
+      case 'J': case 'j': direction = "down"; break;
+      case 'K': case 'k': direction = "up"; break;
+      case 'L': case 'l': direction = "right"; break;
+   }
+   if (direction != nullptr) {
+      if (selected_obj < objects.size()) {
+         vertex step = move_step (direction,
+                                  objects.move_by (selected_obj));
+         pending_move.xpos += step.xpos;
+         pending_move.ypos += step.ypos;
+      }
+      post_mouse (before);
+      return;
+   }
+   flush_move();
+   size_t was_selected = selected_obj;
    switch (key) {
       case 'Q': case 'q': case ESC:
          window::close();
          break;
-      case 'H': case 'h':
-         obj.move("left");
-         break;
-      case 'J': case 'j':
-         obj.move("down");
-         break;
-      case 'K': case 'k':
-         obj.move("up");
-         break;
-      case 'L': case 'l':
-         obj.move("right");
-         break;
       case 'N': case 'n': case SPACE: case TAB:
+         if (objects.empty()) break;
          if(window::selected_obj == window::objects.size()-1)
             window::selected_obj = 0;
          else
             window::selected_obj++;
          break;
       case 'P': case 'p': case BS:
+         if (objects.empty()) break;
          if(window::selected_obj == 0)
             window::selected_obj = window::objects.size()-1;
          else
             window::selected_obj--;
          break;
+      case 'F': case 'f':
+         if (profiler::enabled()) {
+            post (profile_box);
+            profiler::toggle_overlay();
+            profile_box = profile_bounds (profiler::overlay_visible()
+                                          ? profiler::overlay()
+                                          : vector<string>());
+            post (profile_box);
+         }
+         break;
       case '0'...'9':
          if(key-'0' >= 0 && key-'0' < objects.size()) 
             window::selected_obj = key-'0';
@@ -134,13 +578,26 @@ void window::keyboard (GLubyte key, int x, int y) {
          cerr << (unsigned)key << ": invalid keystroke" << endl;
          break;
    }
-   glutPostRedisplay();
+   if (selected_obj != was_selected) {
+      if (was_selected < objects.size()) {
+         post (objects.border_bounds (was_selected));
+      }
+      if (selected_obj < objects.size()) {
+         post (objects.border_bounds (selected_obj));
+      }
+   }
+   post_mouse (before);
 }
 
 
 // Executed when a special function key is pressed.
 void window::special (int key, int x, int y) {
    DEBUGF ('g', "key=" << key << ", x=" << x << ", y=" << y);
+   queue_input ({input_event::kind::special, key, 0, x, y});
+}
+
+void window::handle_special (int key, int x, int y) {
+   mouse before = window::mus;
    window::mus.set (x, y);
    switch (key) {
       case GLUT_KEY_LEFT: //move_selected_object (-1, 0); break;
@@ -163,28 +620,37 @@ void window::special (int key, int x, int y) {
          cerr << unsigned (key) << ": invalid function key" << endl;
          break;
    }
-   glutPostRedisplay();
+   post_mouse (before);
 }
 
 
 void window::motion (int x, int y) {
    DEBUGF ('g', "x=" << x << ", y=" << y);
-   window::mus.set (x, y);
-   glutPostRedisplay();
+   queue_input ({input_event::kind::motion, 0, 0, x, y});
 }
 
 void window::passivemotion (int x, int y) {
    DEBUGF ('g', "x=" << x << ", y=" << y);
+   queue_input ({input_event::kind::motion, 0, 0, x, y});
+}
+
+void window::handle_motion (int x, int y) {
+   mouse before = window::mus;
    window::mus.set (x, y);
-   glutPostRedisplay();
+   post_mouse (before);
 }
 
 void window::mousefn (int button, int state, int x, int y) {
    DEBUGF ('g', "button=" << button << ", state=" << state
            << ", x=" << x << ", y=" << y);
+   queue_input ({input_event::kind::button, button, state, x, y});
+}
+
+void window::handle_button (int button, int state, int x, int y) {
+   mouse before = window::mus;
    window::mus.state (button, state);
    window::mus.set (x, y);
-   glutPostRedisplay();
+   post_mouse (before);
 }
 
 void window::main () {
@@ -203,6 +669,7 @@ void window::main () {
    glutMotionFunc (window::motion);
    glutPassiveMotionFunc (window::passivemotion);
    glutMouseFunc (window::mousefn);
+   start_animation();
    DEBUGF ('g', "Calling glutMainLoop()");
    glutMainLoop();
 }
@@ -214,23 +681,57 @@ void mouse::state (int button, int state) {
       case GLUT_MIDDLE_BUTTON: middle_state = state; break;
       case GLUT_RIGHT_BUTTON: right_state = state; break;
    }
+   relabel();
+}
+
+static void* const mouse_font = GLUT_BITMAP_HELVETICA_18;
+static const vertex mouse_origin (10.0f, 10.0f);
+
+void mouse::relabel() {
+   string text = "(" + to_string (xpos) + ","
+               + to_string (window::height - ypos) + ")";
+   if (left_state == GLUT_DOWN) text += "L";
+   if (middle_state == GLUT_DOWN) text += "M";
+   if (right_state == GLUT_DOWN) text += "R";
+   if (text == label_ and layout.atlas != nullptr) return;
+   label_ = move (text);
+   layout = glyph_cache::layout (mouse_font, label_);
+}
+
+bbox mouse::bounds() const {
+   return bbox (layout.left, layout.bottom, layout.right, layout.top)
+          .offset (mouse_origin);
 }
 
 void mouse::draw() {
    static rgbcolor color ("green");
-   ostringstream text;
-   text << "(" << xpos << "," << window::height - ypos << ")";
-   if (left_state == GLUT_DOWN) text << "L"; 
-   if (middle_state == GLUT_DOWN) text << "M"; 
-   if (right_state == GLUT_DOWN) text << "R"; 
-   if (entered == GLUT_ENTERED) {
-      void* font = GLUT_BITMAP_HELVETICA_18;
-      glColor3ubv (color.ubvec);
-      glRasterPos2i (10, 10);
-      auto ubytes = reinterpret_cast<const GLubyte*>
-                    (text.str().c_str());
-      glutBitmapString (font, ubytes);
+   if (visible()) {
+      render::backend().draw_glyphs (layout, mouse_origin, color);
    }
 }
 
+static void* const profile_font = GLUT_BITMAP_HELVETICA_12;
+static const GLfloat profile_line = 14;
+
+// Profile overlay lines go down from the top left corner.
+static vertex profile_origin (size_t line) {
+   return vertex (10.0f, window::get_height() - (line + 1) * profile_line
+                         - 6.0f);
+}
+
+bbox window::profile_bounds (const vector<string>& lines) {
+   bbox box;
+   for (size_t line = 0; line < lines.size(); ++line) {
+      box.expand (text_extent (profile_font, lines[line])
+                  .offset (profile_origin (line)));
+   }
+   return box;
+}
 
+void window::draw_profile (const vector<string>& lines) {
+   static rgbcolor color ("yellow");
+   for (size_t line = 0; line < lines.size(); ++line) {
+      render::backend().draw_text (profile_font, lines[line],
+                                   profile_origin (line), color);
+   }
+}
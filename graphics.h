@@ -9,10 +9,16 @@ using namespace std;
 
 #include <GL/freeglut.h>
 
+#include "batch.h"
+#include "damage.h"
+#include "input.h"
 #include "rgbcolor.h"
+#include "scene.h"
 #include "shape.h"
+#include "spatial.h"
 
 class object {
+      friend class scene_store;
    private:
       shared_ptr<shape> pshape;
       vertex center;
@@ -33,8 +39,49 @@ class object {
       void move (const string & str);
       void set_border(float width, rgbcolor color);
       void draw_border();
+      const shape& get_shape() const { return *pshape; }
+      const vertex& get_center() const { return center; }
+      const rgbcolor& get_color() const { return color; }
+      bbox bounds() const { return pshape->bounds().offset (center); }
 };
 
+//
+// object_ref -
+//    Handle to an object after it has been pushed into the window,
+//    where it lives in a scene_store.  Same interface as object.
+//    Moves go through the window, so the render list, spatial index
+//    and damage region follow.
+// set_rotation, set_scale -
+//    Turn the object to degrees counterclockwise, or scale it along
+//    its own axes, replacing the previous rotation or scale.  These
+//    also go through the window.
+//
+
+class object_ref {
+   private:
+      size_t slot;
+   public:
+      explicit object_ref (size_t slot): slot(slot) {}
+      void draw();
+      void move (GLfloat delta_x, GLfloat delta_y);
+      void set_move (float x);
+      void move (const string & str);
+      void set_border (float width, rgbcolor color);
+      void set_rotation (float degrees);
+      void set_scale (float xscale, float yscale);
+      void draw_border();
+      vertex get_center() const;
+      const rgbcolor& get_color() const;
+      bbox bounds() const;
+};
+
+//
+// mouse -
+//    Position and buttons, shown as a label in the corner.  The label
+//    and its layout are made again only when they change, not on
+//    every redisplay.
+//
+
 class mouse {
       friend class window;
    private:
@@ -44,21 +91,43 @@ class mouse {
       int left_state {GLUT_UP};
       int middle_state {GLUT_UP};
       int right_state {GLUT_UP};
+      string label_;
+      text_layout layout;
    private:
-      void set (int x, int y) { xpos = x; ypos = y; }
+      void set (int x, int y) { xpos = x; ypos = y; relabel(); }
       void state (int button, int state);
+      void relabel();
+      bool visible() const { return entered == GLUT_ENTERED; }
+      const string& label() const { return label_; }
+      bbox bounds() const;
       void draw();
 };
 
 
 class window {
       friend class mouse;
+      friend class object_ref;
    private:
       static int width;         // in pixels
       static int height;        // in pixels
-      static vector<object> objects;
+      static size_t threads;    // for headless tiles, 0 for all cores
+      static scene_store objects;
+      static render_list batches;
+      static bool batches_stale;
+      static damage_region damaged;
+      static spatial_grid index;
+      static vector<size_t> visible;
+      static vector<size_t> drawn;     // this frame, for the profiler
       static size_t selected_obj;
       static mouse mus;
+      static bbox profile_box;
+      static vector<bbox> moved_from;
+      static bool ticking;      // tick is set to run
+      static input_queue input;
+      static vector<input_event> input_events;
+      static vector<input_queue::clock::time_point> input_stamps;
+      static vertex pending_move;   // of the selected object
+      static vector<void (*)()> closers;
    private:
       static void close();
       static void entry (int mouse_entered);
@@ -69,21 +138,54 @@ class window {
       static void motion (int x, int y);
       static void passivemotion (int x, int y);
       static void mousefn (int button, int state, int x, int y);
+      static void queue_input (const input_event& event);
+      static void handle_input();
+      static void handle_entry (int mouse_entered);
+      static void handle_key (GLubyte key, int x, int y);
+      static void handle_special (int key, int x, int y);
+      static void handle_motion (int x, int y);
+      static void handle_button (int button, int state, int x, int y);
+      static void flush_move();
+      static void tick (int);
+      static void moved (size_t slot, const bbox& from);
+      static void transformed (size_t slot, const bbox& from);
+      static bbox extent (size_t slot);
+      static void post (const bbox& box);
+      static void post_mouse (const mouse& before);
+      static void render_regions (const vector<bbox>& regions,
+                                  bool overlay);
+      static bbox profile_bounds (const vector<string>& lines);
+      static void draw_profile (const vector<string>& lines);
    public:
-      static void push_back (const object& obj) {
-                  objects.push_back (obj); }
+      static void push_back (const object& obj);
+      static void append (const vector<shape_ptr>& shapes,
+                          const scene_columns& columns);
+      static void assign (size_t slot, const object& obj);
+      static void truncate (size_t count);
       static void setwidth (int width_) { width = width_; }
       static void setheight (int height_) { height = height_; }
+      static void setthreads (size_t threads_) { threads = threads_; }
       static void main();
-      static object & get_selected() {
-         return objects[selected_obj];
+      // Run before exit when the window closes, as to stop threads.
+      static void at_close (void (*closer)()) {
+         closers.push_back (closer);
+      }
+      static void render_frame();
+      static void headless (const string& pattern, int frames,
+                            double frame_seconds);
+      static void animate (double seconds);
+      static void fast_forward (double seconds);
+      static void start_animation();
+      static object_ref get_selected() {
+         return object_ref (selected_obj);
       }
-      static object & get_back() {
-         return objects.back();
+      static object_ref get_back() {
+         return object_ref (objects.size() - 1);
       }
       static int num_objects() {
          return objects.size();
       }
+      static const scene_store& scene() { return objects; }
       static int get_width() { return width; }
       static int get_height() { return height; }
 };
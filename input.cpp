@@ -0,0 +1,22 @@
+// $Id$
+
+#include "input.h"
+
+void input_queue::push (const input_event& event) {
+   stamps.push_back (clock::now());
+   if (event.what == input_event::kind::motion and not events.empty()
+       and events.back().what == input_event::kind::motion) {
+      events.back() = event;
+   }else {
+      events.push_back (event);
+   }
+}
+
+void input_queue::take (vector<input_event>& events_,
+                        vector<clock::time_point>& stamps_) {
+   events_.clear();
+   stamps_.clear();
+   events.swap (events_);
+   stamps.swap (stamps_);
+}
+
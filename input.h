@@ -0,0 +1,57 @@
+// $Id$
+
+#ifndef __INPUT_H__
+#define __INPUT_H__
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+//
+// input_event -
+//    One GLUT input callback's arguments.  key is the key, special
+//    key or mouse button; state is the button's state, or whether
+//    the mouse entered the window.  Passive and active motion are
+//    both motion, since they are handled alike.
+//
+
+struct input_event {
+   enum class kind: uint8_t {key, special, motion, button, entry};
+   kind what;
+   int key;
+   int state;
+   int x;
+   int y;
+};
+
+//
+// input_queue -
+//    Events from GLUT callbacks, held until the next frame handles
+//    them all at once.  Each is stamped with the time it arrived, so
+//    the time to the frame that shows it can be measured.
+// push -
+//    Queue an event.  Motion right after motion replaces it, since
+//    only the last position is shown, but the earlier arrival time
+//    is still kept.
+// take -
+//    Move the queued events and all the arrival times into the
+//    given vectors, leaving the queue empty.  The vectors' storage
+//    is swapped in, so nothing is allocated once both have grown.
+//
+
+class input_queue {
+   public:
+      using clock = chrono::steady_clock;
+   private:
+      vector<input_event> events;
+      vector<clock::time_point> stamps;
+   public:
+      void push (const input_event& event);
+      bool empty() const { return stamps.empty(); }
+      void take (vector<input_event>& events_,
+                 vector<clock::time_point>& stamps_);
+};
+
+#endif
+
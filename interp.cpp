@@ -1,193 +1,742 @@
 // $Id: interp.cpp,v 1.3 2016/07/30 22:27:52 akhatri Exp $
 
+#include <algorithm>
+#include <charconv>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 using namespace std;
 
 #include <GL/freeglut.h>
 
+#include "animate.h"
+#include "arena.h"
 #include "debug.h"
 #include "interp.h"
+#include "profile.h"
+#include "script.h"
 #include "shape.h"
+#include "trace.h"
 #include "util.h"
 
-unordered_map<string,interpreter::interpreterfn>
+unordered_map<string_view,interpreter::compilefn>
 interpreter::interp_map {
-   {"define" , &interpreter::do_define },
-   {"draw"   , &interpreter::do_draw   },
-   {"moveby"   , &interpreter::do_moveby},
-   {"border"   , &interpreter::do_border},
+   {"define"  , &interpreter::compile_define  },
+   {"draw"    , &interpreter::compile_draw    },
+   {"moveby"  , &interpreter::compile_moveby  },
+   {"border"  , &interpreter::compile_border  },
+   {"velocity", &interpreter::compile_velocity},
+   {"path"    , &interpreter::compile_path    },
+   {"rotate"  , &interpreter::compile_rotate  },
+   {"scale"   , &interpreter::compile_scale   },
 };
 
-unordered_map<string,interpreter::factoryfn>
+//
+// factory_map gives each shape type its index in factories and the
+// number of parameters it takes (negative for at least that many).
+//
+enum factory_index: uint8_t {
+   TEXT, ELLIPSE, CIRCLE, POLYGON, RECTANGLE, SQUARE, TRIANGLE,
+   EQUILATERAL, DIAMOND,
+};
+
+unordered_map<string_view,uint8_t>
 interpreter::factory_map {
-   {"text"     , &interpreter::make_text     },
-   {"ellipse"  , &interpreter::make_ellipse  },
-   {"circle"   , &interpreter::make_circle   },
-   {"polygon"  , &interpreter::make_polygon  },
-   {"rectangle", &interpreter::make_rectangle},
-   {"square"   , &interpreter::make_square   },
-   {"triangle" , &interpreter::make_triangle },
-   {"equilateral" , &interpreter::make_equilateral },
-   {"diamond" , &interpreter::make_diamond },
+   {"text"       , TEXT       },
+   {"ellipse"    , ELLIPSE    },
+   {"circle"     , CIRCLE     },
+   {"polygon"    , POLYGON    },
+   {"rectangle"  , RECTANGLE  },
+   {"square"     , SQUARE     },
+   {"triangle"   , TRIANGLE   },
+   {"equilateral", EQUILATERAL},
+   {"diamond"    , DIAMOND    },
+};
+
+const interpreter::factoryfn interpreter::factories[] {
+   &interpreter::make_text,
+   &interpreter::make_ellipse,
+   &interpreter::make_circle,
+   &interpreter::make_polygon,
+   &interpreter::make_rectangle,
+   &interpreter::make_square,
+   &interpreter::make_triangle,
+   &interpreter::make_equilateral,
+   &interpreter::make_diamond,
+};
+
+static const int factory_params[] {-1, 2, 1, -2, 2, 1, 6, 1, 2};
+
+static const size_t factory_sizes[] {
+   sizeof (text), sizeof (ellipse), sizeof (circle), sizeof (polygon),
+   sizeof (rectangle), sizeof (square), sizeof (triangle),
+   sizeof (equilateral), sizeof (diamond),
 };
 
 interpreter::shape_map interpreter::objmap;
+unordered_map<string,shape_ptr> interpreter::geometry_cache;
+interpreter::geometry_stats interpreter::geometry;
+static mutex cache_lock;      // reloads evaluate on another thread
 
 interpreter::~interpreter() {
    for (const auto& itor: objmap) {
       cout << "objmap[" << itor.first << "] = "
            << *itor.second << endl;
    }
+   if (profiler::enabled() and geometry.shared != 0) {
+      cerr << "interp: " << geometry.shared << " of "
+           << geometry.defines << " defines shared geometry, "
+           << geometry.bytes_saved << " bytes saved" << endl;
+   }
+   if (profiler::enabled()) shape_arena::report (cerr);
 }
 
-void interpreter::interpret (const parameters& params) {
-   DEBUGF ('i', params);
-   param begin = params.cbegin();
-   string command = *begin;
-   auto itor = interp_map.find (command);
-   if (itor == interp_map.end()) throw runtime_error ("syntax error");
-   interpreterfn func = itor->second;
-    //cout<<"SECOND IS: "<<itor->second<<endl;
-   func (++begin, params.cend());
+//
+// Draw coordinates must be numbers; shape parameters are scanned
+// like atof, taking the longest numeric prefix, or 0.
+//
+static GLfloat strict_number (string_view word) {
+   GLfloat result;
+   auto scan = from_chars (word.data(), word.data() + word.size(),
+                           result);
+   if (scan.ec != errc() or scan.ptr != word.data() + word.size()) {
+      throw runtime_error ("invalid number: " + string (word));
+   }
+   return result;
 }
 
-void interpreter::do_define (param begin, param end) {
-   DEBUGF ('f', range (begin, end));
-   string name = *begin;
-   objmap.emplace (name, make_shape (++begin, end));
+static GLfloat lenient_number (string_view word) {
+   const char* first = word.data();
+   const char* last = first + word.size();
+   if (first != last and *first == '+') ++first;
+   GLfloat result;
+   if (from_chars (first, last, result).ec != errc()) return 0;
+   return result;
 }
 
-
-void interpreter::do_draw (param begin, param end) {
-   DEBUGF ('f', range (begin, end));
-   if (end - begin != 4) throw runtime_error ("syntax error");
-   string name = begin[1];
-   shape_map::const_iterator itor = objmap.find (name);
-  
-   vertex where {from_string<GLfloat> (begin[2]),
-                 from_string<GLfloat> (begin[3])};
-   rgbcolor color {begin[0]};
-   itor->second->draw (where, color);
-   //rgbcolor color {begin[0]};
-   object new_obj(itor->second, where, color);
-   window::push_back(new_obj);
+static uint32_t intern_symbol (interpreter::program& prog,
+                               string_view name) {
+   auto itor = prog.symbol_ids.find (name);
+   if (itor != prog.symbol_ids.end()) return itor->second;
+   uint32_t id = prog.symbols.size();
+   prog.symbols.emplace_back (name);
+   prog.symbol_ids.emplace (name, id);
+   return id;
 }
 
-void interpreter::do_moveby (param begin, param end) {
-   DEBUGF ('f', range (begin, end));
+static uint32_t intern_color (interpreter::program& prog,
+                              string_view name) {
+   auto itor = prog.color_ids.find (name);
+   if (itor != prog.color_ids.end()) return itor->second;
+   rgbcolor color;
+   try {
+      color = rgbcolor (name);
+   }catch (invalid_argument&) {
+      throw runtime_error ("invalid color: " + string (name));
+   }
+   uint32_t id = prog.colors.size();
+   prog.colors.push_back (color);
+   prog.color_ids.emplace (name, id);
+   return id;
+}
 
-   object & curr = window::get_back();
-   float x = atof(begin->c_str());
-   curr.set_move(x);
+//
+// Symbol and color ids are keyed by views into the script text,
+// which must outlive the program.  Errors are kept in the program
+// and reported by compile once every chunk is done.
+//
+void interpreter::compile_chunk (const script_chunk& chunk,
+                                 program& prog) {
+   TRACE_SCOPE ('i', "compile_chunk", chunk.linenr);
+   script_scanner scanner (chunk.text, chunk.linenr);
+   words params;
+   int linenr;
+   while (scanner.next (params, linenr)) {
+      DEBUGF ('i', linenr << ": " << params.size() << " words");
+      try {
+         auto itor = interp_map.find (params[0]);
+         if (itor == interp_map.end()) {
+            throw runtime_error ("syntax error");
+         }
+         instruction instr {};
+         instr.linenr = linenr;
+         instr.first = prog.numbers.size();
+         itor->second (params, prog, instr);
+         prog.code.push_back (instr);
+      }catch (runtime_error& error) {
+         prog.errors.push_back (prog.filename + ":" + to_string (linenr)
+                                + ": " + error.what());
+      }
+   }
 }
 
-shape_ptr interpreter::make_shape (param begin, param end) {
-   DEBUGF ('f', range (begin, end));
-   string type = *begin++;
-   auto itor = factory_map.find(type);
-   
-   factoryfn funct = itor->second;
-   return funct (begin, end);
+void interpreter::append (program& into, program& from) {
+   TRACE_SCOPE ('i', "append", from.code.size());
+   vector<string_view> names (from.symbols.size());
+   for (const auto& entry: from.symbol_ids) {
+      names[entry.second] = entry.first;
+   }
+   vector<uint32_t> symbol_ids (names.size());
+   for (size_t id = 0; id < names.size(); ++id) {
+      symbol_ids[id] = intern_symbol (into, names[id]);
+   }
+   vector<string_view> color_names (from.colors.size());
+   for (const auto& entry: from.color_ids) {
+      color_names[entry.second] = entry.first;
+   }
+   vector<uint32_t> color_ids (from.colors.size());
+   for (size_t id = 0; id < color_names.size(); ++id) {
+      auto found = into.color_ids.emplace (color_names[id],
+                                           into.colors.size());
+      if (found.second) into.colors.push_back (from.colors[id]);
+      color_ids[id] = found.first->second;
+   }
+   uint32_t numbers_base = into.numbers.size();
+   uint32_t strings_base = into.strings.size();
+   into.code.reserve (into.code.size() + from.code.size());
+   for (instruction instr: from.code) {
+      switch (instr.op) {
+         case opcode::define:
+            instr.symbol = symbol_ids[instr.symbol];
+            instr.first += instr.factory == TEXT ? strings_base
+                                                 : numbers_base;
+            break;
+         case opcode::draw:
+            instr.symbol = symbol_ids[instr.symbol];
+            instr.color = color_ids[instr.color];
+            instr.first += numbers_base;
+            break;
+         case opcode::moveby:
+         case opcode::velocity:
+         case opcode::path:
+         case opcode::rotate:
+         case opcode::scale:
+            instr.first += numbers_base;
+            break;
+         case opcode::border:
+            instr.color = color_ids[instr.color];
+            instr.first += numbers_base;
+            break;
+      }
+      into.code.push_back (instr);
+   }
+   into.numbers.insert (into.numbers.end(), from.numbers.begin(),
+                        from.numbers.end());
+   for (string& str: from.strings) into.strings.push_back (move (str));
+   for (string& error: from.errors) into.errors.push_back (move (error));
 }
 
-shape_ptr interpreter::make_text (param begin, param end) {
-  DEBUGF ('f', range (begin, end));
+//
+// Chunks are at least min_chunk bytes, so small scripts are compiled
+// on the calling thread.
+//
+void interpreter::compile (string_view script, program& prog,
+                           size_t threads, vector<string>* errors) {
+   TRACE_SCOPE ('i', "compile", script.size());
+   static constexpr size_t min_chunk = 1 << 18;
+   if (threads == 0) threads = max (thread::hardware_concurrency(), 1u);
+   threads = max<size_t> (1, min (threads, script.size() / min_chunk));
+   vector<script_chunk> chunks = split_script (script, threads);
+   if (chunks.size() <= 1) {
+      compile_chunk ({script, 1}, prog);
+   }else {
+      vector<program> parts (chunks.size());
+      vector<thread> workers;
+      for (size_t index = 0; index < chunks.size(); ++index) {
+         parts[index].filename = prog.filename;
+         workers.emplace_back (compile_chunk, cref (chunks[index]),
+                               ref (parts[index]));
+      }
+      for (thread& worker: workers) worker.join();
+      for (program& part: parts) append (prog, part);
+   }
+   for (string& error: prog.errors) {
+      if (errors == nullptr) {
+         complain() << error << endl;
+      }else {
+         errors->push_back (move (error));
+      }
+   }
+   prog.errors.clear();
+   DEBUGF ('i', prog.filename << ": " << chunks.size() << " chunks, "
+           << prog.code.size() << " instructions, "
+           << prog.symbols.size() << " symbols, "
+           << prog.colors.size() << " colors");
+}
 
-   string font = *begin;
-   ++begin;
-   string str = "";
-   for(auto it = begin; it != end; ++it) {
-      str += *it;
-      str += " ";
+//
+// Bytes a second copy of the shape would have taken: the object
+// with its make_shared control block, and its vertices or its text
+// and layout.
+//
+static size_t shape_bytes (const shape& pshape, uint8_t factory) {
+   size_t bytes = factory_sizes[factory] + 2 * sizeof (long);
+   if (auto shape_text = dynamic_cast<const text*> (&pshape)) {
+      bytes += shape_text->get_textdata().capacity()
+             + shape_text->get_layout().glyphs.capacity()
+             * sizeof (placed_glyph);
+   }else if (auto shape_ellipse = dynamic_cast<const ellipse*>
+                                        (&pshape)) {
+      bytes += shape_ellipse->get_outline().capacity() * sizeof (vertex);
+   }else if (auto shape_polygon = dynamic_cast<const polygon*>
+                                        (&pshape)) {
+      bytes += shape_polygon->get_vertices().capacity()
+             * sizeof (vertex);
    }
-   if(str.length())  {
-      return make_shared<text> (font, 
-             str.substr(0, str.length()-1));
+   return bytes;
+}
+
+//
+// The cache key is the factory index followed by the raw operands:
+// the bytes of each number, or each string ended by a null.
+//
+shape_ptr interpreter::make_shape (const program& prog,
+                                   const instruction& instr) {
+   string key (1, char (instr.factory));
+   if (instr.factory == TEXT) {
+      for (uint32_t index = 0; index < instr.count; ++index) {
+         key += prog.strings[instr.first + index];
+         key += '\0';
+      }
+   }else {
+      key.append (reinterpret_cast<const char*>
+                  (&prog.numbers[instr.first]),
+                  instr.count * sizeof (GLfloat));
    }
-   else {
-      return make_shared<text> (font, str);
+   lock_guard<mutex> guard (cache_lock);
+   ++geometry.defines;
+   auto itor = geometry_cache.find (key);
+   if (itor != geometry_cache.end()) {
+      ++geometry.shared;
+      geometry.bytes_saved += shape_bytes (*itor->second, instr.factory);
+      TRACE ('i', "shared", instr.linenr);
+      return itor->second;
    }
+   shape_ptr pshape = factories[instr.factory] (prog, instr);
+   geometry_cache.emplace (move (key), pshape);
+   return pshape;
 }
 
-shape_ptr interpreter::make_ellipse (param begin, param end) {
-   DEBUGF ('f', range (begin, end));
-   float first = atof(begin->c_str());
-   ++begin;
-   float second = atof(begin->c_str());
-   return make_shared<ellipse> (GLfloat(first), GLfloat(second));
+void interpreter::evaluate (const program& prog, vector<drawing>& drawn,
+                            define_list& defines,
+                            vector<string>* errors) {
+   TRACE_SCOPE ('i', "evaluate", prog.code.size());
+   static const rgbcolor default_border ("red");
+   vector<shape_ptr> shapes (prog.symbols.size());    // by symbol id
+   for (const instruction& instr: prog.code) {
+      try {
+         if (instr.op != opcode::define and instr.op != opcode::draw
+             and drawn.empty()) {
+            throw runtime_error ("no object");
+         }
+         switch (instr.op) {
+            case opcode::define: {
+               if (shapes[instr.symbol] != nullptr) break;
+               TRACE ('i', "define", instr.linenr);
+               shape_ptr pshape = make_shape (prog, instr);
+               shapes[instr.symbol] = pshape;
+               defines.emplace_back (prog.symbols[instr.symbol], pshape);
+               break;
+            }
+            case opcode::draw: {
+               const shape_ptr& pshape = shapes[instr.symbol];
+               if (pshape == nullptr) {
+                  throw runtime_error ("undefined shape: "
+                                       + prog.symbols[instr.symbol]);
+               }
+               const GLfloat* where = &prog.numbers[instr.first];
+               drawing next;
+               next.pshape = pshape;
+               next.center = vertex (where[0], where[1]);
+               next.color = prog.colors[instr.color];
+               next.border_color = default_border;
+               drawn.push_back (move (next));
+               break;
+            }
+            case opcode::moveby: {
+               drawn.back().move_by = prog.numbers[instr.first];
+               break;
+            }
+            case opcode::border: {
+               GLfloat width = prog.numbers[instr.first];
+               if (width > 0) drawn.back().border_width = width;
+               drawn.back().border_color = prog.colors[instr.color];
+               break;
+            }
+            case opcode::velocity: {
+               const GLfloat* speed = &prog.numbers[instr.first];
+               motion_spec& motion = drawn.back().motion;
+               motion.has_velocity = true;
+               motion.velocity = vertex (speed[0], speed[1]);
+               break;
+            }
+            case opcode::path: {
+               const GLfloat* operands = &prog.numbers[instr.first];
+               motion_spec::track track {operands[0], {}};
+               for (uint32_t index = 1; index + 1 < instr.count;
+                    index += 2) {
+                  track.waypoints.push_back (vertex (operands[index],
+                                                     operands[index + 1]));
+               }
+               drawn.back().motion.paths.push_back (move (track));
+               break;
+            }
+            case opcode::rotate: {
+               drawn.back().angle = prog.numbers[instr.first];
+               break;
+            }
+            case opcode::scale: {
+               const GLfloat* scales = &prog.numbers[instr.first];
+               drawn.back().xscale = scales[0];
+               drawn.back().yscale = scales[1];
+               break;
+            }
+         }
+      }catch (runtime_error& error) {
+         TRACE ('i', "error", instr.linenr);
+         string message = prog.filename + ":" + to_string (instr.linenr)
+                        + ": " + error.what();
+         if (errors == nullptr) {
+            complain() << message << endl;
+         }else {
+            errors->push_back (move (message));
+         }
+      }
+   }
 }
 
-shape_ptr interpreter::make_circle (param begin, param end) {
-   DEBUGF ('f', range (begin, end));
-   GLfloat diameter = stof(begin[0]);
-   return make_shared<circle> (diameter);
+// Rotation and scale go through the window after the object is in
+// it, as the commands did.
+void interpreter::transform (size_t slot, const drawing& drawn) {
+   if (drawn.angle != 0) object_ref (slot).set_rotation (drawn.angle);
+   if (drawn.xscale != 1 or drawn.yscale != 1) {
+      object_ref (slot).set_scale (drawn.xscale, drawn.yscale);
+   }
 }
 
-shape_ptr interpreter::make_polygon (param begin, param end) {
-   DEBUGF ('f', range (begin, end));
-   
-   vertex_list vlist;
-   auto itor = begin;
-   while(itor != end) {
-      float first = atof(itor->c_str());
-      ++itor;
-      float second = atof(itor->c_str());
-      ++itor;
-      vlist.push_back(vertex(first, second));
+void interpreter::place (const drawing& drawn) {
+   object obj (drawn.pshape, drawn.center, drawn.color);
+   obj.set_move (drawn.move_by);
+   obj.set_border (drawn.border_width, drawn.border_color);
+   window::push_back (obj);
+   size_t slot = window::num_objects() - 1;
+   transform (slot, drawn);
+   const motion_spec& motion = drawn.motion;
+   if (motion.has_velocity) {
+      animation::set_velocity (slot, motion.velocity.xpos,
+                               motion.velocity.ypos);
+   }
+   for (const auto& track: motion.paths) {
+      animation::add_path (slot, track.period, track.waypoints);
    }
-   return make_shared<polygon> (vlist);
 }
 
-shape_ptr interpreter::make_rectangle (param begin, param end) {
-   DEBUGF ('f', range (begin, end));
-   float first = atof(begin->c_str());
-   ++begin;
-   float second = atof(begin->c_str());
-   return make_shared<rectangle> (GLfloat(first), GLfloat(second));
-}
+vector<interpreter::drawing> interpreter::execute (const program& prog) {
+   vector<drawing> drawn;
+   define_list defines;
+   evaluate (prog, drawn, defines);
+   TRACE_SCOPE ('i', "execute", drawn.size());
+   for (const auto& define: defines) {
+      objmap.emplace (define.first, define.second);
+   }
+   for (const drawing& each: drawn) place (each);
+   return drawn;
+}
 
-shape_ptr interpreter::make_diamond (param begin, param end) {
-    DEBUGF ('f', range (begin, end));
-    GLfloat width = stof(begin[0]);
-    GLfloat height = stof(begin[1]);
-    return make_shared<diamond> (width, height);
-}
-
-shape_ptr interpreter::make_square (param begin, param end) {
-   DEBUGF ('f', range (begin, end));
-   float first = atof(begin->c_str());
-   return make_shared<square> (GLfloat(first));
-}
-
-shape_ptr interpreter::make_triangle (param begin, param end) {
-   DEBUGF('f', range(begin, end));
-   vertex_list vlist;
-   auto itor = begin;
-   
-   while(itor != end) {
-      float first = atof(itor->c_str());
-      ++itor;
-      float second = atof(itor->c_str());
-      ++itor;
-      vlist.push_back(vertex(first, second));
+static bool same_vertex (const vertex& point, const vertex& other) {
+   return point.xpos == other.xpos and point.ypos == other.ypos;
+}
+
+bool interpreter::motion_spec::operator== (const motion_spec& other)
+                                          const {
+   if (has_velocity != other.has_velocity
+       or (has_velocity and not same_vertex (velocity, other.velocity))
+       or paths.size() != other.paths.size()) {
+      return false;
+   }
+   for (size_t index = 0; index < paths.size(); ++index) {
+      const track& path = paths[index];
+      const track& other_path = other.paths[index];
+      if (path.period != other_path.period
+          or not equal (path.waypoints.begin(), path.waypoints.end(),
+                        other_path.waypoints.begin(),
+                        other_path.waypoints.end(), same_vertex)) {
+         return false;
+      }
    }
-   
-   return make_shared<triangle> (vlist[0], vlist[1], vlist[2]);
-} 
+   return true;
+}
+
+static bool same_color (const rgbcolor& color, const rgbcolor& other) {
+   return color.red == other.red and color.green == other.green
+      and color.blue == other.blue;
+}
 
-shape_ptr interpreter::make_equilateral (param begin, param end) {
-   DEBUGF('f', range(begin, end));
-   float first = atof(begin->c_str());
-   return make_shared<equilateral> (GLfloat(first));
+static bool same_drawing (const interpreter::drawing& drawn,
+                          const interpreter::drawing& other) {
+   return drawn.pshape == other.pshape
+      and same_vertex (drawn.center, other.center)
+      and same_color (drawn.color, other.color)
+      and drawn.move_by == other.move_by
+      and drawn.border_width == other.border_width
+      and same_color (drawn.border_color, other.border_color)
+      and drawn.angle == other.angle
+      and drawn.xscale == other.xscale
+      and drawn.yscale == other.yscale
+      and drawn.motion == other.motion;
 }
 
-void interpreter::do_border (param begin, param end) {
-   DEBUGF ('f', range (begin, end));
+//
+// Defines are interned by content, so an unchanged define gives the
+// same shape pointer in both versions and shape changes compare by
+// pointer.
+//
+interpreter::script_edit interpreter::diff (
+      const vector<drawing>& before, const vector<drawing>& after,
+      define_list&& defines) {
+   TRACE_SCOPE ('i', "diff", after.size());
+   script_edit edit;
+   edit.defines = move (defines);
+   edit.keep = min (before.size(), after.size());
+   for (size_t slot = 0; slot < edit.keep and not edit.restart; ++slot) {
+      const drawing& was = before[slot];
+      const drawing& now = after[slot];
+      if (same_drawing (was, now)) continue;
+      edit.restart = was.motion != now.motion;
+      bool moved = was.center.xpos != now.center.xpos
+                or was.center.ypos != now.center.ypos;
+      edit.changed.push_back ({slot, moved, now});
+   }
+   for (size_t slot = edit.keep; slot < before.size(); ++slot) {
+      if (not before[slot].motion.empty()) edit.restart = true;
+   }
+   if (edit.restart) {
+      edit.keep = 0;
+      edit.changed.clear();
+   }
+   edit.appended.assign (after.begin() + edit.keep, after.end());
+   DEBUGF ('i', edit.changed.size() << " changed, "
+           << edit.appended.size() << " appended, keep " << edit.keep
+           << (edit.restart ? ", restart" : ""));
+   return edit;
+}
+
+void interpreter::apply (const script_edit& edit) {
+   TRACE_SCOPE ('i', "apply", edit.changed.size() + edit.appended.size());
+   objmap.clear();
+   for (const auto& define: edit.defines) {
+      objmap.emplace (define.first, define.second);
+   }
+   if (edit.restart) animation::clear();
+   window::truncate (edit.keep);
+   for (const auto& change: edit.changed) {
+      const drawing& now = change.now;
+      object obj (now.pshape, change.moved ? now.center
+                              : object_ref (change.slot).get_center(),
+                  now.color);
+      obj.set_move (now.move_by);
+      obj.set_border (now.border_width, now.border_color);
+      window::assign (change.slot, obj);
+      transform (change.slot, now);
+   }
+   for (const drawing& each: edit.appended) place (each);
+   prune_cache();
+}
+
+//
+// Once an edit is in, the live shapes are those in objmap, in the
+// scene, and in what the watcher last evaluated or has queued.  A
+// shape only the cache holds is none of these, and nothing but a
+// cache lookup, under the lock, can take it again.
+//
+void interpreter::prune_cache() {
+   lock_guard<mutex> guard (cache_lock);
+   size_t before = geometry_cache.size();
+   for (auto itor = geometry_cache.begin();
+        itor != geometry_cache.end();) {
+      if (itor->second.use_count() == 1) {
+         itor = geometry_cache.erase (itor);
+      }else {
+         ++itor;
+      }
+   }
+   DEBUGF ('i', before - geometry_cache.size() << " shapes let go");
+}
+
+void interpreter::compile_define (const words& params, program& prog,
+                                  instruction& instr) {
+   if (params.size() < 3) throw runtime_error ("syntax error");
+   auto itor = factory_map.find (params[2]);
+   if (itor == factory_map.end()) {
+      throw runtime_error ("unknown shape: " + string (params[2]));
+   }
+   int nparams = params.size() - 3;
+   int expected = factory_params[itor->second];
+   bool pairs = itor->second != TEXT;
+   if (expected >= 0 ? nparams != expected
+                     : nparams < -expected or (pairs and nparams % 2)) {
+      throw runtime_error ("wrong number of parameters");
+   }
+   instr.op = opcode::define;
+   instr.factory = itor->second;
+   instr.symbol = intern_symbol (prog, params[1]);
+   if (instr.factory == TEXT) {
+      instr.first = prog.strings.size();
+      instr.count = 2;
+      prog.strings.emplace_back (params[3]);
+      string textdata;
+      for (size_t index = 4; index < params.size(); ++index) {
+         if (index > 4) textdata += ' ';
+         textdata.append (params[index]);
+      }
+      prog.strings.push_back (move (textdata));
+   }else {
+      instr.count = nparams;
+      for (size_t index = 3; index < params.size(); ++index) {
+         prog.numbers.push_back (lenient_number (params[index]));
+      }
+   }
+}
+
+void interpreter::compile_draw (const words& params, program& prog,
+                                instruction& instr) {
+   if (params.size() != 5) throw runtime_error ("syntax error");
+   GLfloat xpos = strict_number (params[3]);
+   GLfloat ypos = strict_number (params[4]);
+   instr.op = opcode::draw;
+   instr.color = intern_color (prog, params[1]);
+   instr.symbol = intern_symbol (prog, params[2]);
+   instr.count = 2;
+   prog.numbers.push_back (xpos);
+   prog.numbers.push_back (ypos);
+}
+
+void interpreter::compile_moveby (const words& params, program& prog,
+                                  instruction& instr) {
+   if (params.size() < 2) throw runtime_error ("syntax error");
+   instr.op = opcode::moveby;
+   instr.count = 1;
+   prog.numbers.push_back (lenient_number (params[1]));
+}
+
+void interpreter::compile_velocity (const words& params, program& prog,
+                                    instruction& instr) {
+   if (params.size() != 3) throw runtime_error ("syntax error");
+   instr.op = opcode::velocity;
+   instr.count = 2;
+   prog.numbers.push_back (strict_number (params[1]));
+   prog.numbers.push_back (strict_number (params[2]));
+}
+
+void interpreter::compile_path (const words& params, program& prog,
+                                instruction& instr) {
+   if (params.size() < 4 or params.size() % 2 != 0) {
+      throw runtime_error ("syntax error");
+   }
+   GLfloat period = strict_number (params[1]);
+   if (not (period > 0)) throw runtime_error ("invalid period");
+   instr.op = opcode::path;
+   instr.count = params.size() - 1;
+   prog.numbers.push_back (period);
+   for (size_t index = 2; index < params.size(); ++index) {
+      prog.numbers.push_back (strict_number (params[index]));
+   }
+}
+
+void interpreter::compile_rotate (const words& params, program& prog,
+                                  instruction& instr) {
+   if (params.size() != 2) throw runtime_error ("syntax error");
+   instr.op = opcode::rotate;
+   instr.count = 1;
+   prog.numbers.push_back (strict_number (params[1]));
+}
+
+void interpreter::compile_scale (const words& params, program& prog,
+                                 instruction& instr) {
+   if (params.size() != 2 and params.size() != 3) {
+      throw runtime_error ("syntax error");
+   }
+   GLfloat xscale = strict_number (params[1]);
+   GLfloat yscale = params.size() == 3 ? strict_number (params[2])
+                                       : xscale;
+   instr.op = opcode::scale;
+   instr.count = 2;
+   prog.numbers.push_back (xscale);
+   prog.numbers.push_back (yscale);
+}
+
+void interpreter::compile_border (const words& params, program& prog,
+                                  instruction& instr) {
+   if (params.size() < 3) throw runtime_error ("syntax error");
+   instr.op = opcode::border;
+   instr.color = intern_color (prog, params[1]);
+   instr.count = 1;
+   prog.numbers.push_back (lenient_number (params[2]));
+}
+
+shape_ptr interpreter::make_text (const program& prog,
+                                  const instruction& instr) {
+   return shape_arena::make<text> (prog.strings[instr.first],
+                                   prog.strings[instr.first + 1]);
+}
+
+shape_ptr interpreter::make_ellipse (const program& prog,
+                                     const instruction& instr) {
+   const GLfloat* param = &prog.numbers[instr.first];
+   return shape_arena::make<ellipse> (param[0], param[1]);
+}
+
+shape_ptr interpreter::make_circle (const program& prog,
+                                    const instruction& instr) {
+   return shape_arena::make<circle> (prog.numbers[instr.first]);
+}
+
+static vertex_list make_vertices (const interpreter::program& prog,
+                                  const interpreter::instruction& instr) {
+   vertex_list vlist (shape_arena::resource());
+   vlist.reserve (instr.count / 2);
+   const GLfloat* param = &prog.numbers[instr.first];
+   for (uint32_t index = 0; index + 1 < instr.count; index += 2) {
+      vlist.push_back (vertex (param[index], param[index + 1]));
+   }
+   return vlist;
+}
+
+shape_ptr interpreter::make_polygon (const program& prog,
+                                     const instruction& instr) {
+   return shape_arena::make<polygon> (make_vertices (prog, instr));
+}
+
+shape_ptr interpreter::make_rectangle (const program& prog,
+                                       const instruction& instr) {
+   const GLfloat* param = &prog.numbers[instr.first];
+   return shape_arena::make<rectangle> (param[0], param[1]);
+}
+
+shape_ptr interpreter::make_diamond (const program& prog,
+                                     const instruction& instr) {
+   const GLfloat* param = &prog.numbers[instr.first];
+   return shape_arena::make<diamond> (param[0], param[1]);
+}
+
+shape_ptr interpreter::make_square (const program& prog,
+                                    const instruction& instr) {
+   return shape_arena::make<square> (prog.numbers[instr.first]);
+}
+
+shape_ptr interpreter::make_triangle (const program& prog,
+                                      const instruction& instr) {
+   const GLfloat* param = &prog.numbers[instr.first];
+   return shape_arena::make<triangle> (vertex (param[0], param[1]),
+                                       vertex (param[2], param[3]),
+                                       vertex (param[4], param[5]));
+}
 
-   object & curr = window::get_back();
-   rgbcolor color {begin[0]};
-   float a = atof(begin[1].c_str());
-   curr.set_border(a, color);
+shape_ptr interpreter::make_equilateral (const program& prog,
+                                         const instruction& instr) {
+   return shape_arena::make<equilateral> (prog.numbers[instr.first]);
 }
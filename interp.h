@@ -3,51 +3,227 @@
 #ifndef __INTERP_H__
 #define __INTERP_H__
 
+#include <cstdint>
 #include <iostream>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 using namespace std;
 
 #include "debug.h"
 #include "graphics.h"
+#include "script.h"
 #include "shape.h"
 
+//
+// interpreter -
+//    Scripts are run in two passes.  compile turns the script text
+//    into a program: every command name, shape type, shape name and
+//    color is resolved to an integer id and every number is parsed
+//    once, so execute is a tight loop over fixed-size instructions
+//    with no string lookups.  Errors in either pass are reported
+//    with the script line and the command is skipped.
+// compile -
+//    A large script is cut into chunks at command boundaries and the
+//    chunks are compiled on separate threads into their own programs,
+//    which are then appended in script order.  Ids are renumbered as
+//    if the script had been compiled serially, errors are reported in
+//    line order, and execute still runs one thread in script order,
+//    so defines, draws and the moveby and border that follow a draw
+//    behave exactly as on one thread.  If errors is given, messages
+//    go there instead of to complain, for a caller on another thread
+//    to pass to the main thread.
+// velocity, path -
+//    Commands that, like moveby and border, apply to the object
+//    drawn last: "velocity vx vy" in pixels per second, and
+//    "path seconds x y [x y]..." to loop through waypoints relative
+//    to the object's center.  The animation class moves them.
+// rotate, scale -
+//    Also apply to the object drawn last: "rotate degrees" turns it
+//    counterclockwise about its center, and "scale sx [sy]" scales it
+//    along its own axes, by sx in both if sy is missing.  Each
+//    replaces the previous rotation or scale.  Text is not affected.
+// geometry -
+//    Defines are interned by content: a define with the same shape
+//    type and parameters as an earlier one, under any name, shares
+//    that shape, and with it the scene's tessellation.  Shapes are
+//    immutable once made.  stats counts the sharing and estimates
+//    the bytes it saved.
+// drawing -
+//    What one draw command puts in the window, with the commands
+//    after it that change the same object.  angle is in degrees, as
+//    in the script.
+// motion_spec -
+//    A drawing's velocity, if it was given one, the last one given,
+//    and its paths in script order, each a period and waypoints.
+//// evaluate -
+//    Run a program without touching the window or objmap: what it
+//    draws, and its defines in the order they were made.  Errors are
+//    reported with their script lines, or kept in errors as compile
+//    does.  Safe to call on any thread, one at a time.
+// execute -
+//    Evaluate a program, then put what it draws in the window and
+//    its defines in objmap.  Returns what was drawn.
+// diff, apply -
+//    Live reload.  diff compares what an edited script draws with
+//    what the previous version drew, and keeps only the changes.  An
+//    object whose drawing changed is updated in place, and keeps
+//    where it has been moved to unless its draw command moved it.
+//    Objects past the end of the shorter list are dropped or added.
+//    Velocities and paths cannot be taken back, so if an animated
+//    object changes or is dropped the whole scene is replaced
+//    instead.  apply makes the edit, on the main thread; diff, like
+//    evaluate, may run on another.  errors holds the messages from
+//    compiling and evaluating the edited script, which the main
+//    thread reports.  After an edit, shapes that nothing defines or
+//    draws any more are dropped from the geometry cache, as the
+//    scene drops their geometries, so they are freed.
+//
+
 class interpreter {
    public:
       using shape_map = unordered_map<string,shape_ptr>;
-      using parameters = vector<string>;
-      using param = parameters::const_iterator;
-      using range = pair<param,param>;
-      void interpret (const parameters&);
+      using words = vector<string_view>;
+      enum class opcode: uint8_t {define, draw, moveby, border,
+                                  velocity, path, rotate, scale};
+      struct instruction {
+         opcode op;
+         uint8_t factory;     // define: index into factories
+         uint32_t linenr;
+         uint32_t symbol;     // define, draw: shape name id
+         uint32_t color;      // draw, border: color id
+         uint32_t first;      // first operand in numbers or strings
+         uint32_t count;      // number of operands
+      };
+      struct program {
+         string filename;
+         vector<instruction> code;
+         vector<GLfloat> numbers;
+         vector<string> strings;      // text fonts and contents
+         vector<string> symbols;      // shape names, by id
+         vector<rgbcolor> colors;     // by id
+         unordered_map<string_view,uint32_t> symbol_ids;
+         unordered_map<string_view,uint32_t> color_ids;
+         vector<string> errors;
+      };
+      struct geometry_stats {
+         size_t defines {0};
+         size_t shared {0};
+         size_t bytes_saved {0};
+      };
+      struct motion_spec {
+         struct track {
+            GLfloat period;
+            vertex_list waypoints;
+         };
+         bool has_velocity {false};
+         vertex velocity {0.0f, 0.0f};
+         vector<track> paths;
+         bool empty() const { return not has_velocity and paths.empty(); }
+         bool operator== (const motion_spec& other) const;
+         bool operator!= (const motion_spec& other) const {
+            return not (*this == other);
+         }
+      };
+      struct drawing {
+         shape_ptr pshape;
+         vertex center;
+         rgbcolor color;
+         GLfloat move_by {4};         // as object starts
+         GLfloat border_width {4};
+         rgbcolor border_color;
+         GLfloat angle {0};
+         GLfloat xscale {1};
+         GLfloat yscale {1};
+         motion_spec motion;
+      };
+      using define_list = vector<pair<string,shape_ptr>>;
+      struct script_edit {
+         struct change {
+            size_t slot;
+            bool moved;
+            drawing now;
+         };
+         define_list defines;
+         bool restart {false};
+         size_t keep {0};             // objects before appended
+         vector<change> changed;      // below keep
+         vector<drawing> appended;
+         vector<string> errors;
+      };
+      static void compile (string_view script, program&,
+                           size_t threads = 0,
+                           vector<string>* errors = nullptr);
+      static void evaluate (const program&, vector<drawing>& drawn,
+                            define_list& defines,
+                            vector<string>* errors = nullptr);
+      vector<drawing> execute (const program&);
+      static script_edit diff (const vector<drawing>& before,
+                               const vector<drawing>& after,
+                               define_list&& defines);
+      static void apply (const script_edit&);
+      static const shape_map& get_objmap() { return objmap; }
+      static const geometry_stats& stats() { return geometry; }
+      static void define (const string& name, const shape_ptr& pshape) {
+         objmap.emplace (name, pshape);
+      }
       interpreter() {}
       ~interpreter();
       interpreter (const interpreter&) = delete;
       interpreter& operator= (const interpreter&) = delete;
 
    private:
-      using interpreterfn = void (*) (param, param);
-      using factoryfn = shape_ptr (*) (param, param);
+      using compilefn = void (*) (const words&, program&,
+                                  instruction&);
+      using factoryfn = shape_ptr (*) (const program&,
+                                       const instruction&);
 
-      static unordered_map<string,interpreterfn> interp_map;
-      static unordered_map<string,factoryfn> factory_map;
+      static unordered_map<string_view,compilefn> interp_map;
+      static unordered_map<string_view,uint8_t> factory_map;
+      static const factoryfn factories[];
       static shape_map objmap;
+      static unordered_map<string,shape_ptr> geometry_cache;
+      static geometry_stats geometry;
+
+      static void compile_chunk (const script_chunk&, program&);
+      static void append (program& into, program& from);
+      static shape_ptr make_shape (const program&, const instruction&);
+      static void prune_cache();
+      static void place (const drawing&);
+      static void transform (size_t slot, const drawing&);
+
+      static void compile_define (const words&, program&,
+                                  instruction&);
+      static void compile_border (const words&, program&,
+                                  instruction&);
+      static void compile_draw (const words&, program&,
+                                instruction&);
+      static void compile_moveby (const words&, program&,
+                                  instruction&);
+      static void compile_velocity (const words&, program&,
+                                    instruction&);
+      static void compile_path (const words&, program&, instruction&);
+      static void compile_rotate (const words&, program&,
+                                  instruction&);
+      static void compile_scale (const words&, program&, instruction&);
 
-      static void do_define (param begin, param end);
-      static void do_border (param begin, param end);
-      static void do_draw (param begin, param end);
-      static void do_moveby (param begin, param end);
-
-      static shape_ptr make_shape (param begin, param end);
-      static shape_ptr make_text (param begin, param end);
-      static shape_ptr make_ellipse (param begin, param end);
-      static shape_ptr make_circle (param begin, param end);
-      static shape_ptr make_polygon (param begin, param end);
-      static shape_ptr make_rectangle (param begin, param end);
-      static shape_ptr make_square (param begin, param end);
-      static shape_ptr make_line (param begin, param end);
-      static shape_ptr make_triangle (param begin, param end);
-      static shape_ptr make_equilateral (param begin, param end);
-      static shape_ptr make_diamond (param begin, param end);
+      static shape_ptr make_text (const program&, const instruction&);
+      static shape_ptr make_ellipse (const program&,
+                                     const instruction&);
+      static shape_ptr make_circle (const program&, const instruction&);
+      static shape_ptr make_polygon (const program&,
+                                     const instruction&);
+      static shape_ptr make_rectangle (const program&,
+                                       const instruction&);
+      static shape_ptr make_square (const program&, const instruction&);
+      static shape_ptr make_triangle (const program&,
+                                      const instruction&);
+      static shape_ptr make_equilateral (const program&,
+                                         const instruction&);
+      static shape_ptr make_diamond (const program&,
+                                     const instruction&);
 };
 
 #endif
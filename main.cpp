@@ -1,61 +1,77 @@
 // $Id: main.cpp,v 1.3 2016/07/30 22:27:52 akhatri Exp $
 
-#include <fstream>
 #include <iostream>
 #include <unistd.h>
 #include <vector>
 using namespace std;
 
+#include "animate.h"
+#include "arena.h"
 #include "debug.h"
+#include "frames.h"
 #include "graphics.h"
 #include "interp.h"
+#include "profile.h"
+#include "script.h"
+#include "snapshot.h"
+#include "trace.h"
 #include "util.h"
+#include "watch.h"
 
 //
-// Parse a file.  Read lines from input file, parse each line,
-// and interpret the command.
+// Parse a file.  The whole script is compiled first, then run, so
+// every error is reported with the line its command starts on.
+// Returns what it drew, for a reload to compare against.
 //
 
-void parsefile (const string& infilename, istream& infile) {
-   interpreter::shape_map shapemap;
+vector<interpreter::drawing> parsefile (const string& infilename,
+                                        const script_source& source) {
    interpreter interp;
-   for (int linenr = 1;; ++linenr) {
-      try {
-         string line;
-         getline (infile, line);
-         if (infile.eof()) break;
-         if (line.size() == 0) continue;
-         for (;;) {
-            DEBUGF ('m', line);
-            int last = line.size() - 1;
-            if (line[last] != '\\') break;
-            line[last] = ' ';
-            string contin;
-            getline (infile, contin);
-            if (infile.eof()) break;
-            line += contin;
-         }
-         interpreter::parameters words = split (line, " \t");
-         if (words.size() == 0 or words.front()[0] == '#') continue;
-         DEBUGF ('m', words);
-         interp.interpret (words);
-      }catch (runtime_error error) {
-         complain() << infilename << ":" << linenr << ": "
-                    << error.what() << endl;
-      }
-   }
+   interpreter::program prog;
+   prog.filename = infilename;
+   interp.compile (source.text(), prog);
+   vector<interpreter::drawing> drawn = interp.execute (prog);
    DEBUGF ('m', infilename << " EOF");
+   return drawn;
 }
 
-
+
 //
 // Scan the option -@ and check for operands.
+// -o names a file to render into instead of opening a window, PNG
+// if it ends in .png and PPM otherwise.  -n renders that many frames,
+// -r apart in animation time (60 a second by default), and then -o
+// needs a %d conversion, as in frame%04d.png, for the frame number.
+// -j sets how many threads draw tiles of each frame, all cores if 0.
+// -l loads a snapshot in place of a script; -s saves the scene to a
+// snapshot once it is loaded.  -p turns on the frame profiler, with
+// its overlay (toggled by F) and a report on cerr at exit.
+// -t turns on binary tracing for the given flags, as -@ does for
+// DEBUGF; the trace is written at exit to gdraw.trace, or to the
+// file named by -T.  Convert it to JSON with gdraw-trace.
+// -a runs the animation for the given number of seconds before the
+// first frame, as fast as it can.
+// -m allocates shapes and their vertices from an arena that is never
+// freed, which loads large scenes faster; with -p, the memory they
+// took is reported either way.  It applies only to the first load,
+// not to a watched script's reloads.
+// A script file given as an operand is watched while the window is
+// open, and edits to it are shown as soon as it is saved.
 //
 
+string outfilename;
+string loadfilename;
+string savefilename;
+string tracefilename = "gdraw.trace";
+string traceflags;
+double animateseconds = 0;
+int framecount = 1;
+double framerate = 60;
+
 void scan_options (int argc, char** argv) {
    opterr = 0;
    for (;;) {
-      int option = getopt (argc, argv, "@:w:h:");
+      int option = getopt (argc, argv, "@:w:h:o:n:r:j:l:s:pt:T:a:m");
       if (option == EOF) break;
       switch (option) {
          case '@':
@@ -67,6 +83,39 @@ void scan_options (int argc, char** argv) {
          case 'h':
             window::setheight (stoi (optarg));
             break;
+         case 'o':
+            outfilename = optarg;
+            break;
+         case 'n':
+            framecount = stoi (optarg);
+            break;
+         case 'r':
+            framerate = stod (optarg);
+            break;
+         case 'j':
+            window::setthreads (stoul (optarg));
+            break;
+         case 'l':
+            loadfilename = optarg;
+            break;
+         case 's':
+            savefilename = optarg;
+            break;
+         case 'p':
+            profiler::enable();
+            break;
+         case 't':
+            traceflags = optarg;
+            break;
+         case 'T':
+            tracefilename = optarg;
+            break;
+         case 'a':
+            animateseconds = stod (optarg);
+            break;
+         case 'm':
+            shape_arena::enable();
+            break;
          default:
             complain() << "-" << char (optopt) << ": invalid option"
                        << endl;
@@ -81,27 +130,61 @@ void scan_options (int argc, char** argv) {
 int main (int argc, char** argv) {
    sys_info::execname (argv[0]);
    scan_options (argc, argv);
+   if (traceflags.size() != 0) {
+      tracer::setflags (traceflags);
+      tracer::open (tracefilename);
+   }
    vector<string> args (&argv[optind], &argv[argc]);
-   //Initialize glut
-   glutInit(&argc, argv);
-   if (args.size() == 0) {
-      parsefile ("-", cin);
-   }else if (args.size() > 1) {
+   vector<interpreter::drawing> drawn;   // by a watched script
+   if (framecount < 1 or framerate <= 0) {
+      complain() << "-n and -r must be positive" << endl;
+      return sys_info::exit_status();
+   }
+   if (framecount > 1 and not frame_pattern (outfilename)) {
+      complain() << "-n " << framecount << ": -o needs a %d conversion"
+                 << endl;
+      return sys_info::exit_status();
+   }
+   //Initialize glut, unless rendering headless
+   if (outfilename.size() == 0) glutInit(&argc, argv);
+   if (args.size() > 1 or (args.size() != 0 and loadfilename.size())) {
       cerr << "Usage: " << sys_info::execname() << "-@flags"
-           << "[filename]" << endl;
+           << " [-p] [-m] [-t flags] [-T trace] [-a seconds]"
+           << " [-o image.ppm|image.png [-n frames] [-r rate]"
+           << " [-j threads]]"
+           << " [-s scene.snap]"
+           << " [-l scene.snap | filename]" << endl;
+   }else if (loadfilename.size() != 0) {
+      interpreter interp;   // shows the loaded objmap, as parsefile does
+      snapshot::load (loadfilename);
+   }else if (args.size() == 0) {
+      script_source source (cin);
+      parsefile ("-", source);
    }else {
       const string infilename = args[0];
-      ifstream infile (infilename.c_str());
-      if (infile.fail()) {
+      script_source source (infilename);
+      if (source.fail()) {
          syscall_error (infilename);
       }else {
          DEBUGF ('m', infilename << "(opened OK)");
-         parsefile (infilename, infile);
-         // fstream objects auto closed when destroyed
+         vector<interpreter::drawing> parsed = parsefile (infilename,
+                                                          source);
+         if (outfilename.size() == 0) drawn = move (parsed);
       }
    }
    int status = sys_info::exit_status();
    if (status != 0) return status;
+   if (savefilename.size() != 0) {
+      snapshot::save (savefilename);
+      status = sys_info::exit_status();
+      if (status != 0) return status;
+   }
+   window::fast_forward (animateseconds);
+   if (outfilename.size() != 0) {
+      window::headless (outfilename, framecount, 1 / framerate);
+      return sys_info::exit_status();
+   }
+   if (args.size() != 0) script_watcher::start (args[0], move (drawn));
    window::main();
    return 0;
 }
@@ -0,0 +1,315 @@
+// $Id$
+
+//
+// gdraw-microbench -
+//    Times the small, hot pieces of gdraw one at a time and writes
+//    the results to cout as JSON, for comparing one version against
+//    another.  Each benchmark is calibrated to run for at least
+//    min_seconds per sample, and reports the fastest and the median
+//    of several samples, in nanoseconds per operation, and the
+//    fastest as operations per second.  The transform benchmarks
+//    count one operation per vertex, so that is vertices per second.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+using namespace std;
+
+#include "debug.h"
+#include "glyph.h"
+#include "graphics.h"
+#include "interp.h"
+#include "raster.h"
+#include "rgbcolor.h"
+#include "script.h"
+#include "shape.h"
+#include "transform.h"
+#include "util.h"
+
+struct result {
+   string name;
+   size_t ops;
+   double min_ns;
+   double median_ns;
+};
+
+vector<result> results;
+double min_seconds = 0.02;
+int samples = 5;
+string only;
+volatile size_t sink;
+
+//
+// Time func, which does ops operations per call.  max_ops bounds
+// the operations in one sample, for benchmarks that grow the scene.
+//
+template <typename func_t>
+void measure (const string& name, size_t ops, func_t func,
+              size_t max_ops = SIZE_MAX) {
+   if (only.size() != 0 and name.find (only) == string::npos) return;
+   using clock = chrono::steady_clock;
+   auto run = [&] (size_t calls) {
+      auto start = clock::now();
+      for (size_t call = 0; call < calls; ++call) func();
+      chrono::duration<double> elapsed = clock::now() - start;
+      return elapsed.count();
+   };
+   size_t calls = 1;
+   while (run (calls) < min_seconds and (calls * 2) * ops <= max_ops) {
+      calls *= 2;
+   }
+   vector<double> times;
+   for (int sample = 0; sample < samples; ++sample) {
+      times.push_back (run (calls) * 1e9 / (calls * ops));
+   }
+   sort (times.begin(), times.end());
+   results.push_back ({name, calls * ops, times.front(),
+                       times[times.size() / 2]});
+   DEBUGF ('B', name << ": " << times.front() << " ns/op");
+}
+
+string repeat (const string& line, size_t count) {
+   string text;
+   for (size_t index = 0; index < count; ++index) text += line;
+   return text;
+}
+
+void bench_util() {
+   const string line = "draw red circle 100.5 -200.25";
+   measure ("util/split", 1, [&] {
+      sink = split (line, " \t").size();
+   });
+   const string number = "123.456";
+   measure ("util/from_string<GLfloat>", 1, [&] {
+      sink = from_string<GLfloat> (number);
+   });
+   const string name = "ForestGreen";
+   measure ("rgbcolor/name", 1, [&] {
+      sink = rgbcolor (name).red;
+   });
+   const string hex = "0x3A7FC0";
+   measure ("rgbcolor/hex", 1, [&] {
+      sink = rgbcolor (hex).red;
+   });
+}
+
+void bench_interp() {
+   // Never destroyed: its destructor lists objmap on cout.
+   static interpreter& interp = *new interpreter();
+   const size_t lines = 1000;
+   const vector<pair<string,string>> commands {
+      {"define", "define box rectangle 20 10\n"},
+      {"draw"  , "draw red box 320.5 240.25\n"},
+      {"moveby", "moveby 8\n"},
+      {"border", "border blue 2\n"},
+   };
+   string mixed;
+   for (const auto& command: commands) mixed += command.second;
+   string scan_text = repeat (mixed, lines / commands.size());
+   measure ("script/scan", lines, [&] {
+      script_scanner scanner (scan_text);
+      vector<string_view> words;
+      int linenr;
+      size_t count = 0;
+      while (scanner.next (words, linenr)) count += words.size();
+      sink = count;
+   });
+   for (const auto& command: commands) {
+      string text = repeat (command.second, lines);
+      measure ("interp/compile/" + command.first, lines, [&] {
+         interpreter::program prog;
+         interp.compile (text, prog, 1);
+         sink = prog.code.size();
+      });
+   }
+   string setup = commands[0].second + commands[1].second;
+   interpreter::program defined;
+   interp.compile (setup, defined, 1);
+   interp.execute (defined);
+   for (size_t index = 1; index < commands.size(); ++index) {
+      const auto& command = commands[index];
+      string text = setup + repeat (command.second, lines);
+      interpreter::program prog;
+      interp.compile (text, prog, 1);
+      measure ("interp/execute/" + command.first, lines, [&] {
+         interp.execute (prog);
+      }, 1 << 18);
+   }
+}
+
+void bench_shapes() {
+   measure ("factory/text", 1, [] {
+      sink = make_shared<text> (string ("Helvetica-18"),
+                                string ("Hello world")).use_count();
+   });
+   measure ("factory/ellipse", 1, [] {
+      sink = make_shared<ellipse> (GLfloat (60), GLfloat (30))
+             .use_count();
+   });
+   measure ("factory/circle", 1, [] {
+      sink = make_shared<circle> (GLfloat (40)).use_count();
+   });
+   vertex_list points {{0.0f, 0.0f}, {40.0f, 0.0f}, {50.0f, 30.0f},
+                       {20.0f, 50.0f}, {-10.0f, 30.0f}};
+   measure ("factory/polygon", 1, [&] {
+      sink = make_shared<polygon> (points).use_count();
+   });
+   measure ("factory/rectangle", 1, [] {
+      sink = make_shared<rectangle> (GLfloat (60), GLfloat (40))
+             .use_count();
+   });
+   measure ("factory/square", 1, [] {
+      sink = make_shared<square> (GLfloat (30)).use_count();
+   });
+   measure ("factory/triangle", 1, [] {
+      sink = make_shared<triangle> (vertex (-20.0f, -20.0f),
+                                    vertex (20.0f, -20.0f),
+                                    vertex (0.0f, 30.0f)).use_count();
+   });
+   measure ("factory/equilateral", 1, [] {
+      sink = make_shared<equilateral> (GLfloat (30)).use_count();
+   });
+   measure ("factory/diamond", 1, [] {
+      sink = make_shared<diamond> (GLfloat (40), GLfloat (60))
+             .use_count();
+   });
+   for (GLfloat diameter: {10.0f, 100.0f, 1000.0f}) {
+      ostringstream name;
+      name << "vertices/ellipse/" << diameter;
+      measure (name.str(), 1, [diameter] {
+         ellipse shape (diameter, diameter);
+         sink = shape.get_outline().size();
+      });
+   }
+   vertex_list triangles;
+   ellipse round (GLfloat (100), GLfloat (100));
+   measure ("vertices/ellipse/100/tessellate", 1, [&] {
+      triangles.clear();
+      round.tessellate (triangles);
+      sink = triangles.size();
+   });
+   polygon pentagon (points);
+   measure ("vertices/polygon/5/tessellate", 1, [&] {
+      triangles.clear();
+      pentagon.tessellate (triangles);
+      sink = triangles.size();
+   });
+   vertex_list star;
+   for (int index = 0; index < 64; ++index) {
+      double angle = index * M_PI / 32;
+      double radius = index % 2 == 0 ? 50 : 20;
+      star.push_back (vertex (radius * cos (angle), radius * sin (angle)));
+   }
+   measure ("vertices/polygon/star/64/triangulate", 1, [&] {
+      sink = make_shared<polygon> (star).use_count();
+   });
+   const vertex_list& rim = round.get_outline();
+   measure ("vertices/ellipse/100/stroke", 1, [&] {
+      triangles.clear();
+      stroke_outline (rim.data(), rim.size(), 4, triangles);
+      sink = triangles.size();
+   });
+}
+
+void bench_text() {
+   const string label ("Hello world, 1234567890");
+   measure ("text/layout", 1, [&] {
+      sink = glyph_cache::layout (GLUT_BITMAP_HELVETICA_18, label)
+             .glyphs.size();
+   });
+   framebuffer image (640, 480);
+   raster_backend cpu (image);
+   cpu.begin_frame (640, 480);
+   cpu.clear_region (bbox (0, 0, 640, 480));
+   rgbcolor white ("white");
+   vertex where (100.0f, 200.0f);
+   measure ("text/raster/draw_text", 1, [&] {
+      cpu.draw_text (GLUT_BITMAP_HELVETICA_18, label, where, white);
+   });
+   text cached (GLUT_BITMAP_HELVETICA_18, label);
+   measure ("text/raster/draw_glyphs", 1, [&] {
+      cpu.draw_glyphs (cached.get_layout(), where, white);
+   });
+}
+
+void bench_transform() {
+   const size_t count = 4096;
+   vertex_list local;
+   for (size_t index = 0; index < count; ++index) {
+      local.push_back (vertex (GLfloat (index % 64) - 32,
+                               GLfloat (index / 64) - 32));
+   }
+   vertex_list world (count);
+   transform2d xform (vertex (320.5f, 240.25f), 0.5f, 2.0f, 0.75f);
+   measure ("transform/scalar", count, [&] {
+      transform_vertices_scalar (xform, local.data(), count,
+                                 world.data());
+      sink = size_t (world.back().xpos);
+   });
+   if (transform_has_avx2()) {
+      measure ("transform/avx2", count, [&] {
+         transform_vertices_avx2 (xform, local.data(), count,
+                                  world.data());
+         sink = size_t (world.back().xpos);
+      });
+   }
+}
+
+void write_json (ostream& out) {
+   out << "{\n"
+       << "  \"format\": 1,\n"
+#ifdef __OPTIMIZE__
+       << "  \"optimized\": true,\n"
+#else
+       << "  \"optimized\": false,\n"
+#endif
+       << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+       << "  \"date\": \"" << datestring() << "\",\n"
+       << "  \"benchmarks\": [\n";
+   for (size_t index = 0; index < results.size(); ++index) {
+      const result& each = results[index];
+      out << "    {\"name\": \"" << each.name << "\", \"ops\": "
+          << each.ops << ", \"min_ns\": " << each.min_ns
+          << ", \"median_ns\": " << each.median_ns
+          << ", \"per_second\": " << 1e9 / each.min_ns << "}"
+          << (index + 1 < results.size() ? "," : "") << "\n";
+   }
+   out << "  ]\n}" << endl;
+}
+
+//
+// -t sets min_seconds, -s the number of samples, and -b runs only
+// the benchmarks whose names contain the given string.
+//
+int main (int argc, char** argv) {
+   sys_info::execname (argv[0]);
+   opterr = 0;
+   for (;;) {
+      int option = getopt (argc, argv, "@:t:s:b:");
+      if (option == EOF) break;
+      switch (option) {
+         case '@': debugflags::setflags (optarg); break;
+         case 't': min_seconds = stod (optarg); break;
+         case 's': samples = max (1, stoi (optarg)); break;
+         case 'b': only = optarg; break;
+         default:
+            complain() << "-" << char (optopt) << ": invalid option"
+                       << endl;
+            break;
+      }
+   }
+   if (sys_info::exit_status() != 0) return sys_info::exit_status();
+   bench_util();
+   bench_interp();
+   bench_shapes();
+   bench_text();
+   bench_transform();
+   write_json (cout);
+   return 0;
+}
@@ -0,0 +1,100 @@
+// $Id$
+
+#include "pool.h"
+#include "trace.h"
+
+work_pool::work_pool (size_t workers) {
+   for (size_t worker = 0; worker < max<size_t> (workers, 1); ++worker) {
+      queues.emplace_back (new queue);
+   }
+   for (size_t worker = 1; worker < queues.size(); ++worker) {
+      threads.emplace_back (&work_pool::work, this, worker);
+   }
+}
+
+work_pool::~work_pool() {
+   {
+      lock_guard<mutex> guard (lock);
+      stopping = true;
+   }
+   started.notify_all();
+   for (thread& each: threads) each.join();
+}
+
+// The worker's own block from the front, else the back of the next
+// block that has anything left.
+bool work_pool::take (size_t worker, size_t& index) {
+   for (size_t offset = 0; offset < queues.size(); ++offset) {
+      queue& from = *queues[(worker + offset) % queues.size()];
+      lock_guard<mutex> guard (from.lock);
+      if (from.tasks.empty()) continue;
+      if (offset == 0) {
+         index = from.tasks.front();
+         from.tasks.pop_front();
+      }else {
+         index = from.tasks.back();
+         from.tasks.pop_back();
+      }
+      return true;
+   }
+   return false;
+}
+
+//
+// task and total are set before any index is queued, and a queue's
+// lock orders that before any worker takes the index, so a worker
+// still draining after the last job can only ever see the new one.
+//
+void work_pool::drain (size_t worker) {
+   size_t index;
+   while (take (worker, index)) {
+      (*task) (index, worker);
+      if (++finished == total) {
+         lock_guard<mutex> guard (lock);
+         done.notify_all();
+      }
+   }
+}
+
+void work_pool::work (size_t worker) {
+   size_t seen = 0;
+   unique_lock<mutex> guard (lock);
+   for (;;) {
+      started.wait (guard, [&] {
+         return stopping or generation != seen;
+      });
+      if (stopping) return;
+      seen = generation;
+      guard.unlock();
+      drain (worker);
+      guard.lock();
+   }
+}
+
+void work_pool::run (size_t count,
+                     const function<void(size_t,size_t)>& task_) {
+   if (count == 0) return;
+   TRACE_SCOPE ('w', "pool run", count);
+   task = &task_;
+   total = count;
+   finished = 0;
+   size_t workers = queues.size();
+   for (size_t worker = 0; worker < workers; ++worker) {
+      lock_guard<mutex> guard (queues[worker]->lock);
+      for (size_t index = count * worker / workers;
+           index < count * (worker + 1) / workers; ++index) {
+         queues[worker]->tasks.push_back (index);
+      }
+   }
+   if (workers > 1) {
+      {
+         lock_guard<mutex> guard (lock);
+         ++generation;
+      }
+      started.notify_all();
+   }
+   drain (0);
+   unique_lock<mutex> guard (lock);
+   done.wait (guard, [&] { return finished == total; });
+}
+
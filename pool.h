@@ -0,0 +1,60 @@
+// $Id$
+
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+//
+// work_pool -
+//    A fixed set of workers for splitting one job into many small
+//    tasks.  The thread calling run is worker 0 and the pool starts
+//    size() - 1 threads more, which sleep between jobs.
+// run -
+//    Call task (index, worker) for every index below count, and
+//    return once all are done.  Each worker is dealt a contiguous
+//    block of indices, which it takes from the front; a worker that
+//    runs out steals from the back of another's block, so neighbours
+//    stay on one worker unless the load is uneven.  Calls with the
+//    same worker never overlap, so worker can index state owned by
+//    each worker.
+//
+
+class work_pool {
+   private:
+      struct queue {
+         mutex lock;
+         deque<size_t> tasks;
+      };
+      vector<unique_ptr<queue>> queues;     // one per worker
+      vector<thread> threads;
+      const function<void(size_t,size_t)>* task {nullptr};
+      size_t total {0};
+      atomic<size_t> finished {0};
+      size_t generation {0};
+      bool stopping {false};
+      mutex lock;
+      condition_variable started;
+      condition_variable done;
+      bool take (size_t worker, size_t& index);
+      void drain (size_t worker);
+      void work (size_t worker);
+   public:
+      explicit work_pool (size_t workers);
+      ~work_pool();
+      work_pool (const work_pool&) = delete;
+      work_pool& operator= (const work_pool&) = delete;
+      size_t size() const { return queues.size(); }
+      void run (size_t count, const function<void(size_t,size_t)>& task);
+};
+
+#endif
+
@@ -0,0 +1,231 @@
+// $Id$
+
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+using namespace std;
+
+#include "debug.h"
+#include "profile.h"
+#include "util.h"
+
+bool profiler::enabled_ = false;
+bool profiler::overlay_ = false;
+vector<profiler::class_stats> profiler::classes;
+size_t profiler::buckets[num_buckets];
+profiler::clock::time_point profiler::frame_start;
+size_t profiler::frames = 0;
+double profiler::total_seconds = 0;
+double profiler::min_seconds = 0;
+double profiler::max_seconds = 0;
+double profiler::last_seconds = 0;
+size_t profiler::frame_objects = 0;
+size_t profiler::frame_vertices = 0;
+size_t profiler::total_objects = 0;
+size_t profiler::total_vertices = 0;
+size_t profiler::max_objects = 0;
+size_t profiler::max_vertices = 0;
+size_t profiler::update_steps = 0;
+double profiler::update_seconds = 0;
+double profiler::max_update_seconds = 0;
+size_t profiler::update_objects = 0;
+vector<float> profiler::latencies;
+
+//
+// Bucket 0 holds frames under 0.25 ms; each bucket after it doubles
+// the limit, and the last holds everything slower.
+//
+static double bucket_limit (size_t bucket) {
+   return 0.25e-3 * (size_t (1) << bucket);
+}
+
+uint16_t profiler::class_id (const shape& pshape) {
+   string name = demangle (pshape);
+   for (size_t id = 0; id < classes.size(); ++id) {
+      if (classes[id].name == name) return id;
+   }
+   classes.push_back ({});
+   classes.back().name = name;
+   return classes.size() - 1;
+}
+
+void profiler::begin_frame() {
+   if (not enabled_) return;
+   frame_objects = 0;
+   frame_vertices = 0;
+   frame_start = clock::now();
+}
+
+void profiler::end_frame() {
+   if (not enabled_) return;
+   chrono::duration<double> elapsed = clock::now() - frame_start;
+   double seconds = elapsed.count();
+   size_t bucket = 0;
+   while (bucket + 1 < num_buckets and seconds >= bucket_limit (bucket)) {
+      ++bucket;
+   }
+   ++buckets[bucket];
+   min_seconds = frames == 0 ? seconds : min (min_seconds, seconds);
+   max_seconds = max (max_seconds, seconds);
+   total_seconds += seconds;
+   last_seconds = seconds;
+   ++frames;
+   total_objects += frame_objects;
+   total_vertices += frame_vertices;
+   max_objects = max (max_objects, frame_objects);
+   max_vertices = max (max_vertices, frame_vertices);
+   DEBUGF ('p', "frame " << frames << ": " << seconds * 1e3 << " ms, "
+           << frame_objects << " objects, " << frame_vertices
+           << " vertices");
+}
+
+void profiler::add (uint16_t class_id, double seconds) {
+   static mutex lock;
+   lock_guard<mutex> guard (lock);
+   class_stats& stats = classes[class_id];
+   stats.seconds += seconds;
+   ++stats.calls;
+}
+
+void profiler::add_objects (uint16_t class_id, size_t objects,
+                            size_t vertices) {
+   class_stats& stats = classes[class_id];
+   stats.objects += objects;
+   stats.vertices += vertices;
+   frame_objects += objects;
+   frame_vertices += vertices;
+}
+
+void profiler::add_update (double seconds, size_t steps,
+                           size_t objects) {
+   update_steps += steps;
+   update_seconds += seconds;
+   max_update_seconds = max (max_update_seconds, seconds / steps);
+   update_objects = objects;
+}
+
+void profiler::add_latency (double seconds) {
+   if (not enabled_) return;
+   latencies.push_back (seconds);
+}
+
+//
+// The value fraction of the samples are at or below, to the nearest
+// sample.  Reorders them.
+//
+static double percentile (vector<float>& samples, double fraction) {
+   auto nth = samples.begin()
+            + size_t (fraction * (samples.size() - 1) + 0.5);
+   nth_element (samples.begin(), nth, samples.end());
+   return *nth;
+}
+
+//
+// Classes in decreasing order of total draw time.
+//
+static vector<size_t> by_time (const vector<double>& seconds) {
+   vector<size_t> order (seconds.size());
+   for (size_t id = 0; id < order.size(); ++id) order[id] = id;
+   stable_sort (order.begin(), order.end(), [&] (size_t a, size_t b) {
+      return seconds[a] > seconds[b];
+   });
+   return order;
+}
+
+vector<string> profiler::overlay() {
+   vector<string> lines;
+   if (frames == 0) return lines;
+   ostringstream line;
+   line << fixed << setprecision (2) << "frame " << last_seconds * 1e3
+        << " ms, mean " << total_seconds / frames * 1e3 << ", max "
+        << max_seconds * 1e3;
+   lines.push_back (line.str());
+   line.str ("");
+   line << frame_objects << " objects, " << frame_vertices
+        << " vertices";
+   lines.push_back (line.str());
+   if (update_steps != 0) {
+      line.str ("");
+      line << "update " << update_seconds / update_steps * 1e3
+           << " ms/step, " << update_objects << " moving";
+      lines.push_back (line.str());
+   }
+   if (latencies.size() != 0) {
+      size_t count = min (latencies.size(), size_t (latency_window));
+      vector<float> recent (latencies.end() - count, latencies.end());
+      line.str ("");
+      line << "input p50 " << percentile (recent, 0.5) * 1e3
+           << " ms, p99 " << percentile (recent, 0.99) * 1e3;
+      lines.push_back (line.str());
+   }
+   vector<double> seconds;
+   for (const auto& stats: classes) seconds.push_back (stats.seconds);
+   size_t limit = lines.size() + 3;
+   for (size_t id: by_time (seconds)) {
+      if (lines.size() == limit or classes[id].calls == 0) break;
+      line.str ("");
+      line << classes[id].name << " " << classes[id].seconds / frames
+              * 1e3 << " ms/frame";
+      lines.push_back (line.str());
+   }
+   return lines;
+}
+
+void profiler::report (ostream& out) {
+   if (not enabled_) return;
+   out << fixed << setprecision (3);
+   if (update_steps != 0) {
+      out << "profile: " << update_steps << " update steps, mean "
+          << update_seconds / update_steps * 1e3 << " ms, max "
+          << max_update_seconds * 1e3 << " ms, " << update_objects
+          << " moving" << endl;
+   }
+   if (latencies.size() != 0) {
+      vector<float> all = latencies;
+      out << "profile: " << all.size() << " input events, to display p50 "
+          << percentile (all, 0.5) * 1e3 << " ms, p90 "
+          << percentile (all, 0.9) * 1e3 << " ms, p99 "
+          << percentile (all, 0.99) * 1e3 << " ms, max "
+          << percentile (all, 1) * 1e3 << " ms" << endl;
+   }
+   out << "profile: " << frames << " frames";
+   if (frames == 0) {
+      out << endl;
+      return;
+   }
+   out << ", mean " << total_seconds / frames * 1e3 << " ms, min "
+       << min_seconds * 1e3 << " ms, max " << max_seconds * 1e3
+       << " ms" << endl;
+   out << "profile: objects/frame mean " << total_objects / frames
+       << ", max " << max_objects << "; vertices/frame mean "
+       << total_vertices / frames << ", max " << max_vertices << endl;
+   size_t most = *max_element (begin (buckets), end (buckets));
+   for (size_t bucket = 0; bucket < num_buckets; ++bucket) {
+      out << "profile: " << (bucket + 1 < num_buckets ? "< " : ">=")
+          << setw (8) << bucket_limit (min (bucket, num_buckets - 2))
+                         * 1e3
+          << " ms " << setw (8) << buckets[bucket];
+      if (buckets[bucket] != 0) {
+         out << " " << string (buckets[bucket] * 40 / most, '#');
+      }
+      out << endl;
+   }
+   out << "profile: " << left << setw (14) << "class" << right
+       << setw (10) << "objects" << setw (12) << "vertices"
+       << setw (10) << "calls" << setw (12) << "total ms"
+       << setw (12) << "ns/object" << endl;
+   vector<double> seconds;
+   for (const auto& stats: classes) seconds.push_back (stats.seconds);
+   for (size_t id: by_time (seconds)) {
+      const class_stats& stats = classes[id];
+      out << "profile: " << left << setw (14) << stats.name << right
+          << setw (10) << stats.objects << setw (12) << stats.vertices
+          << setw (10) << stats.calls << setw (12)
+          << stats.seconds * 1e3 << setw (12)
+          << (stats.objects == 0 ? 0 : stats.seconds * 1e9
+                                       / stats.objects)
+          << endl;
+   }
+   out << defaultfloat;
+}
@@ -0,0 +1,103 @@
+// $Id$
+
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "shape.h"
+
+//
+// profiler -
+//    Static class that times frames and the drawing of each shape
+//    class.  Off unless enabled; when off, nothing is timed.
+// class_id -
+//    Small id for the shape's class, named as demangle names it for
+//    shape::show.  Looked up once per distinct shape, by scene_store.
+// begin_frame, end_frame -
+//    Bracket one frame.  Its time goes into a histogram, with the
+//    objects and vertices submitted during it.
+// add -
+//    Charge time to a shape class.  Called by render_list::submit
+//    for each run it draws.  Times are CPU time to submit; with the
+//    GL backend the GPU may still be drawing.  Safe to call from any
+//    thread, so tiles drawn in parallel are each charged, and their
+//    times add up to more than the frame.
+// add_objects -
+//    Count objects and vertices for a shape class and the frame.
+//    Called by the window at the end of a frame, once for each
+//    object drawn in any of its regions or tiles.  Not locked: main
+//    thread only, between begin_frame and end_frame.
+// add_update -
+//    Charge time to animation, for steps that moved objects.  Kept
+//    apart from frames, so update and render costs can be compared.
+// add_latency -
+//    Record the time from an input event's arrival to the end of
+//    the frame that handled it.  Reported as percentiles, of the
+//    last latency_window events in the overlay and of all of them
+//    at exit.
+// overlay -
+//    A few lines summarizing recent frames, for drawing on screen.
+// report -
+//    Everything recorded, as text.
+//
+
+class profiler {
+   public:
+      using clock = chrono::steady_clock;
+      static const size_t num_buckets = 12;
+      static const size_t latency_window = 256;
+   private:
+      struct class_stats {
+         string name;
+         double seconds {0};
+         size_t objects {0};
+         size_t vertices {0};
+         size_t calls {0};
+      };
+      static bool enabled_;
+      static bool overlay_;
+      static vector<class_stats> classes;
+      static size_t buckets[num_buckets];
+      static clock::time_point frame_start;
+      static size_t frames;
+      static double total_seconds;
+      static double min_seconds;
+      static double max_seconds;
+      static double last_seconds;
+      static size_t frame_objects;
+      static size_t frame_vertices;
+      static size_t total_objects;
+      static size_t total_vertices;
+      static size_t max_objects;
+      static size_t max_vertices;
+      static size_t update_steps;
+      static double update_seconds;
+      static double max_update_seconds;
+      static size_t update_objects;
+      static vector<float> latencies;
+   public:
+      static void enable() { enabled_ = overlay_ = true; }
+      static bool enabled() { return enabled_; }
+      static void toggle_overlay() { overlay_ = not overlay_; }
+      static bool overlay_visible() { return enabled_ and overlay_; }
+      static uint16_t class_id (const shape& pshape);
+      static void begin_frame();
+      static void end_frame();
+      static void add (uint16_t class_id, double seconds);
+      static void add_objects (uint16_t class_id, size_t objects,
+                               size_t vertices);
+      static void add_update (double seconds, size_t steps,
+                              size_t objects);
+      static void add_latency (double seconds);
+      static vector<string> overlay();
+      static void report (ostream& out);
+};
+
+#endif
+
@@ -0,0 +1,476 @@
+// $Id$
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+#include <GL/freeglut.h>
+#include <zlib.h>
+
+#include "batch.h"
+#include "raster.h"
+#include "shape.h"
+#include "trace.h"
+
+void framebuffer::resize (int width, int height) {
+   width_ = max (width, 0);
+   height_ = max (height, 0);
+   pixels.assign (size_t (width_) * height_ * 3, 0);
+}
+
+void framebuffer::clear (const rgbcolor& color) {
+   for (size_t index = 0; index < pixels.size(); index += 3) {
+      pixels[index] = color.red;
+      pixels[index + 1] = color.green;
+      pixels[index + 2] = color.blue;
+   }
+}
+
+void framebuffer::write_ppm (ostream& out) const {
+   out << "P6\n" << width_ << " " << height_ << "\n255\n";
+   for (int y = height_ - 1; y >= 0; --y) {
+      out.write (reinterpret_cast<const char*> (row (y)), width_ * 3);
+   }
+}
+
+// A PNG chunk is its length, type, data, and a CRC of the type and
+// data, with every number big-endian.
+static void write_uint32 (ostream& out, uint32_t value) {
+   char bytes[] {char (value >> 24), char (value >> 16),
+                 char (value >> 8), char (value)};
+   out.write (bytes, sizeof bytes);
+}
+
+static void write_chunk (ostream& out, const char* type,
+                         const Bytef* data, uint32_t length) {
+   uLong crc = crc32 (0, Z_NULL, 0);
+   crc = crc32 (crc, reinterpret_cast<const Bytef*> (type), 4);
+   if (length > 0) crc = crc32 (crc, data, length);
+   write_uint32 (out, length);
+   out.write (type, 4);
+   out.write (reinterpret_cast<const char*> (data), length);
+   write_uint32 (out, crc);
+}
+
+bool framebuffer::write_png (ostream& out) const {
+   size_t stride = size_t (width_) * 3 + 1;
+   vector<Bytef> rows (stride * height_);
+   for (int y = 0; y < height_; ++y) {
+      Bytef* line = &rows[stride * (height_ - 1 - y)];
+      line[0] = 0;
+      copy (row (y), row (y) + width_ * 3, line + 1);
+   }
+   uLongf length = compressBound (rows.size());
+   vector<Bytef> deflated (length);
+   if (compress2 (deflated.data(), &length, rows.data(), rows.size(),
+                  Z_BEST_SPEED) != Z_OK) return false;
+   Bytef header[13] {
+      Bytef (width_ >> 24), Bytef (width_ >> 16), Bytef (width_ >> 8),
+      Bytef (width_), Bytef (height_ >> 24), Bytef (height_ >> 16),
+      Bytef (height_ >> 8), Bytef (height_),
+      8, 2, 0, 0, 0,     // 8-bit RGB, methods 0, not interlaced
+   };
+   out.write ("\x89PNG\r\n\x1a\n", 8);
+   write_chunk (out, "IHDR", header, sizeof header);
+   write_chunk (out, "IDAT", deflated.data(), length);
+   write_chunk (out, "IEND", nullptr, 0);
+   return true;
+}
+
+raster_backend::raster_backend (framebuffer& fb): fb(fb) {
+}
+
+void raster_backend::begin_frame (int width, int height) {
+   if (width != fb.width() or height != fb.height()) {
+      fb.resize (width, height);
+   }
+   clip_left = clip_bottom = clip_right = clip_top = 0;
+   masks.clear();
+}
+
+void raster_backend::clear_region (const bbox& region) {
+   clip_left = max (int (region.left), 0);
+   clip_bottom = max (int (region.bottom), 0);
+   clip_right = min (int (region.right), fb.width());
+   clip_top = min (int (region.top), fb.height());
+   for (int y = clip_bottom; y < clip_top; ++y) {
+      GLubyte* pixel = fb.row (y) + clip_left * 3;
+      for (int x = clip_left; x < clip_right; ++x) {
+         *pixel++ = background.red;
+         *pixel++ = background.green;
+         *pixel++ = background.blue;
+      }
+   }
+}
+
+void raster_backend::end_frame() {
+}
+
+void raster_backend::span (int y, int x0, int x1,
+                           const rgbcolor& color) {
+   x0 = max (x0, clip_left);
+   x1 = min (x1, clip_right);
+   if (x0 >= x1) return;
+   GLubyte* pixel = fb.row (y) + x0 * 3;
+   for (int x = x0; x < x1; ++x) {
+      *pixel++ = color.red;
+      *pixel++ = color.green;
+      *pixel++ = color.blue;
+   }
+   stats_.pixels += x1 - x0;
+}
+
+//
+// Scanline fill with an active edge table.  Scanline y samples at
+// y + 0.5, and a pixel is covered if its center lies inside.  Rows
+// from bottom up to top are scanned, and each covered span is handed
+// to emit (y, x0, x1).
+//
+
+template <typename emit_t>
+void raster_backend::scan_polygon (const vertex* vertices, size_t count,
+                                   const vertex& offset, int bottom,
+                                   int top, emit_t emit) {
+   if (count < 3) return;
+   edges.clear();
+   for (size_t index = 0; index < count; ++index) {
+      const vertex& from = vertices[index];
+      const vertex& to = vertices[(index + 1) % count];
+      GLfloat y0 = from.ypos + offset.ypos;
+      GLfloat y1 = to.ypos + offset.ypos;
+      if (y0 == y1) continue;
+      GLfloat x0 = from.xpos + offset.xpos;
+      GLfloat x1 = to.xpos + offset.xpos;
+      int winding = 1;
+      if (y0 > y1) { swap (x0, x1); swap (y0, y1); winding = -1; }
+      raster_edge edge;
+      edge.ystart = max (int (ceil (y0 - 0.5f)), bottom);
+      edge.yend = min (int (ceil (y1 - 0.5f)), top);
+      if (edge.ystart >= edge.yend) continue;
+      edge.dxdy = (x1 - x0) / (y1 - y0);
+      edge.x = x0 + (edge.ystart + 0.5f - y0) * edge.dxdy;
+      edge.winding = winding;
+      edges.push_back (edge);
+   }
+   if (edges.empty()) return;
+   sort (edges.begin(), edges.end(),
+         [] (const raster_edge& a, const raster_edge& b) {
+            return a.ystart < b.ystart; });
+
+   active.clear();
+   size_t next = 0;
+   int yend = 0;
+   for (const auto& edge: edges) yend = max (yend, edge.yend);
+   for (int y = edges.front().ystart; y < yend; ++y) {
+      while (next < edges.size() and edges[next].ystart == y) {
+         active.push_back (&edges[next++]);
+      }
+      active.erase (remove_if (active.begin(), active.end(),
+                    [y] (const raster_edge* edge) {
+                       return edge->yend <= y; }),
+                    active.end());
+      crossings.clear();
+      for (raster_edge* edge: active) {
+         crossings.emplace_back (edge->x, edge->winding);
+         edge->x += edge->dxdy;
+      }
+      sort (crossings.begin(), crossings.end());
+      int winding = 0;
+      for (size_t index = 0; index + 1 < crossings.size(); ++index) {
+         winding += crossings[index].second;
+         if (winding == 0) continue;
+         int x0 = int (ceil (crossings[index].first - 0.5f));
+         int x1 = int (ceil (crossings[index + 1].first - 0.5f));
+         emit (y, x0, x1);
+      }
+   }
+}
+
+//
+// A polygon wholly outside the clip rectangle is skipped before its
+// edges are set up.  Most are, when a region is drawn as tiles.
+//
+void raster_backend::scan_polygon (const vertex* vertices, size_t count,
+                                   const vertex& offset,
+                                   const rgbcolor& color) {
+   if (count == 0) return;
+   GLfloat left = vertices[0].xpos;
+   GLfloat right = left;
+   GLfloat bottom = vertices[0].ypos;
+   GLfloat top = bottom;
+   for (size_t index = 1; index < count; ++index) {
+      left = min (left, vertices[index].xpos);
+      right = max (right, vertices[index].xpos);
+      bottom = min (bottom, vertices[index].ypos);
+      top = max (top, vertices[index].ypos);
+   }
+   if (ceil (right + offset.xpos - 0.5f) <= clip_left
+       or ceil (left + offset.xpos - 0.5f) >= clip_right
+       or ceil (top + offset.ypos - 0.5f) <= clip_bottom
+       or ceil (bottom + offset.ypos - 0.5f) >= clip_top) return;
+   scan_polygon (vertices, count, offset, clip_bottom, clip_top,
+                 [this, &color] (int y, int x0, int x1) {
+                    span (y, x0, x1, color);
+                 });
+}
+
+void raster_backend::fill_polygon (const vertex* vertices, size_t count,
+                                   const vertex& offset,
+                                   const rgbcolor& color) {
+   ++stats_.primitives;
+   scan_polygon (vertices, count, offset, color);
+}
+
+void raster_backend::fill_triangles (const vertex* vertices,
+                                     size_t count, const vertex& offset,
+                                     const rgbcolor& color) {
+   ++stats_.primitives;
+   for (size_t index = 0; index + 2 < count; index += 3) {
+      scan_polygon (vertices + index, 3, offset, color);
+   }
+}
+
+void raster_backend::draw_lines (const vertex* vertices, size_t count,
+                                 const vertex& offset, GLfloat width,
+                                 const rgbcolor& color) {
+   ++stats_.primitives;
+   GLfloat half = max (width, 1.0f) / 2;
+   for (size_t index = 0; index + 1 < count; index += 2) {
+      const vertex& from = vertices[index];
+      const vertex& to = vertices[index + 1];
+      GLfloat dx = to.xpos - from.xpos;
+      GLfloat dy = to.ypos - from.ypos;
+      GLfloat length = hypot (dx, dy);
+      if (length == 0) continue;
+      GLfloat nx = -dy / length * half;
+      GLfloat ny = dx / length * half;
+      vertex quad[] {
+         {from.xpos + nx, from.ypos + ny},
+         {to.xpos + nx, to.ypos + ny},
+         {to.xpos - nx, to.ypos - ny},
+         {from.xpos - nx, from.ypos - ny},
+      };
+      scan_polygon (quad, 4, offset, color);
+   }
+}
+
+//
+// Hands each run of set pixels of laid out text, drawn from (xpos,
+// ypos), to emit (y, x0, x1).
+//
+template <typename emit_t>
+void raster_backend::scan_glyphs (const text_layout& layout, int xpos,
+                                  int ypos, emit_t emit) {
+   if (layout.atlas == nullptr) return;
+   const glyph_atlas& atlas = *layout.atlas;
+   for (const placed_glyph& each: layout.glyphs) {
+      const glyph& cell = atlas.glyphs[each.code];
+      int left = xpos + each.xpos;
+      int bottom = ypos + each.ypos;
+      const glyph_run* runs = &atlas.runs[cell.first_run];
+      for (uint32_t run = 0; run < cell.run_count; ++run) {
+         emit (bottom + runs[run].y, left + runs[run].x0,
+               left + runs[run].x1);
+      }
+   }
+}
+
+void raster_backend::draw_glyphs (const text_layout& layout,
+                                  const vertex& where,
+                                  const rgbcolor& color) {
+   ++stats_.primitives;
+   scan_glyphs (layout, int (where.xpos), int (where.ypos),
+                [this, &color] (int y, int x0, int x1) {
+      if (y < clip_bottom or y >= clip_top) return;
+      span (y, x0, x1, color);
+   });
+}
+
+void raster_backend::draw_triangles (render_list& list, size_t first,
+                                     size_t count) {
+   ++stats_.primitives;
+   const vertex* vertices = list.vertices() + first;
+   const rgbcolor* colors = list.colors() + first;
+   static const vertex origin (0.0f, 0.0f);
+   for (size_t index = 0; index + 2 < count; index += 3) {
+      scan_polygon (vertices + index, 3, origin, colors[index]);
+   }
+}
+
+
+//
+// Spans are sorted by row and overlapping or touching spans merged,
+// so each pixel is stamped once.
+//
+const vector<coverage_span>& raster_backend::mask (
+      uint32_t geometry_id, const scene_store::geometry& info) {
+   auto itor = masks.find (geometry_id);
+   if (itor != masks.end()) return itor->second;
+   vector<coverage_span> spans;
+   if (info.kind == shape_kind::text) {
+      scan_glyphs (*info.layout, 0, 0, [&spans] (int y, int x0, int x1) {
+         spans.push_back ({y, x0, x1});
+      });
+   }else {
+      static const vertex origin (0.0f, 0.0f);
+      auto emit = [&spans] (int y, int x0, int x1) {
+         if (x0 < x1) spans.push_back ({y, x0, x1});
+      };
+      const vertex_list& triangles = info.triangles;
+      if (triangles.empty()) {
+         scan_polygon (info.outline.data(), info.outline.size(), origin,
+                       INT_MIN, INT_MAX, emit);
+      }
+      for (size_t index = 0; index + 2 < triangles.size(); index += 3) {
+         scan_polygon (&triangles[index], 3, origin, INT_MIN, INT_MAX,
+                       emit);
+      }
+   }
+   sort (spans.begin(), spans.end(),
+         [] (const coverage_span& a, const coverage_span& b) {
+            return a.y != b.y ? a.y < b.y : a.x0 < b.x0; });
+   vector<coverage_span> merged;
+   for (const auto& each: spans) {
+      if (not merged.empty() and merged.back().y == each.y
+          and merged.back().x1 >= each.x0) {
+         merged.back().x1 = max (merged.back().x1, each.x1);
+      }else {
+         merged.push_back (each);
+      }
+   }
+   return masks.emplace (geometry_id, move (merged)).first->second;
+}
+
+void raster_backend::stamp (const vector<coverage_span>& spans,
+                            int xpos, int ypos, const rgbcolor& color) {
+   for (const auto& each: spans) {
+      int y = each.y + ypos;
+      if (y < clip_bottom) continue;
+      if (y >= clip_top) break;
+      span (y, each.x0 + xpos, each.x1 + xpos, color);
+   }
+}
+
+void raster_backend::draw_instances (uint32_t geometry_id,
+                                     const scene_store::geometry& info,
+                                     const transform2d& linear,
+                                     const vertex* centers,
+                                     const rgbcolor* colors,
+                                     size_t count) {
+   bool text = info.kind == shape_kind::text;
+   bool moved_only = text or linear.is_translation();
+   if (not moved_only) {
+      const vertex_list& local = info.triangles.empty() ? info.outline
+                                                        : info.triangles;
+      shaped.resize (local.size());
+      transform_vertices (linear, local.data(), local.size(),
+                          shaped.data());
+   }
+   const vector<coverage_span>* spans = nullptr;
+   for (size_t index = 0; index < count; ++index) {
+      ++stats_.primitives;
+      const vertex& center = centers[index];
+      if (not moved_only) {
+         if (info.triangles.empty()) {
+            scan_polygon (shaped.data(), shaped.size(), center,
+                          colors[index]);
+         }
+         for (size_t vert = 0; vert + 2 < info.triangles.size();
+              vert += 3) {
+            scan_polygon (&shaped[vert], 3, center, colors[index]);
+         }
+         continue;
+      }
+      int xpos = text ? int (center.xpos) : int (floor (center.xpos));
+      int ypos = text ? int (center.ypos) : int (floor (center.ypos));
+      if (not text and (xpos != center.xpos or ypos != center.ypos)) {
+         const vertex_list& triangles = info.triangles;
+         if (triangles.empty()) {
+            scan_polygon (info.outline.data(), info.outline.size(),
+                          center, colors[index]);
+         }
+         for (size_t vert = 0; vert + 2 < triangles.size(); vert += 3) {
+            scan_polygon (&triangles[vert], 3, center, colors[index]);
+         }
+         continue;
+      }
+      if (spans == nullptr) spans = &mask (geometry_id, info);
+      stamp (*spans, xpos, ypos, colors[index]);
+   }
+}
+
+tiled_backend::tiled_backend (framebuffer& fb, size_t threads,
+                              int tile_size):
+               raster_backend (fb), tile_size (max (tile_size, 1)),
+               pool (threads) {
+   for (size_t worker = 0; worker < pool.size(); ++worker) {
+      workers.emplace_back (new raster_backend (fb));
+   }
+}
+
+void tiled_backend::begin_frame (int width, int height) {
+   raster_backend::begin_frame (width, height);
+   for (auto& worker: workers) {
+      worker->begin_frame (width, height);
+      worker->background = background;
+   }
+}
+
+void tiled_backend::draw_region (const bbox& region,
+                                 const scene_store& scene,
+                                 render_list& list,
+                                 const vector<size_t>& visible) {
+   TRACE_SCOPE ('w', "draw_region", visible.size());
+   clip_left = max (int (region.left), 0);
+   clip_bottom = max (int (region.bottom), 0);
+   clip_right = min (int (region.right), fb.width());
+   clip_top = min (int (region.top), fb.height());
+   if (clip_left >= clip_right or clip_bottom >= clip_top) return;
+   int first_col = clip_left / tile_size;
+   int first_row = clip_bottom / tile_size;
+   int cols = (clip_right - 1) / tile_size - first_col + 1;
+   int rows = (clip_top - 1) / tile_size - first_row + 1;
+   tiles.clear();
+   for (int row = first_row; row < first_row + rows; ++row) {
+      for (int col = first_col; col < first_col + cols; ++col) {
+         tiles.push_back (bbox (
+               max (col * tile_size, clip_left),
+               max (row * tile_size, clip_bottom),
+               min ((col + 1) * tile_size, clip_right),
+               min ((row + 1) * tile_size, clip_top)));
+      }
+   }
+   bins.resize (max (bins.size(), tiles.size()));
+   for (auto& bin: bins) bin.clear();
+   for (size_t slot: visible) {
+      bbox box = scene.bounds (slot);
+      int left = max (int (floor (box.left)), clip_left);
+      int bottom = max (int (floor (box.bottom)), clip_bottom);
+      int right = min (int (ceil (box.right)), clip_right);
+      int top = min (int (ceil (box.top)), clip_top);
+      if (left >= right or bottom >= top) continue;
+      for (int row = bottom / tile_size; row <= (top - 1) / tile_size;
+           ++row) {
+         for (int col = left / tile_size;
+              col <= (right - 1) / tile_size; ++col) {
+            bins[(row - first_row) * cols + col - first_col]
+                  .push_back (slot);
+         }
+      }
+   }
+   pool.run (tiles.size(), [&] (size_t tile, size_t worker) {
+      raster_backend& cpu = *workers[worker];
+      render_backend& previous = render::backend();
+      render::use (cpu);
+      cpu.clear_region (tiles[tile]);
+      list.submit (scene, bins[tile]);
+      render::use (previous);
+   });
+   for (auto& worker: workers) {
+      stats_.primitives += worker->stats_.primitives;
+      stats_.pixels += worker->stats_.pixels;
+      worker->reset_stats();
+   }
+}
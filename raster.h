@@ -0,0 +1,184 @@
+// $Id$
+
+#ifndef __RASTER_H__
+#define __RASTER_H__
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+#include <GL/freeglut.h>
+
+#include "pool.h"
+#include "render.h"
+#include "rgbcolor.h"
+
+//
+// framebuffer -
+//    In-memory RGB image, three bytes per pixel.  Row 0 is the
+//    bottom of the image, matching GL window coordinates.
+// write_ppm -
+//    Write the image as a binary PPM (P6), top row first.
+// write_png -
+//    Write the image as an 8-bit RGB PNG, top row first, deflated
+//    at zlib's fastest level with no row filters.  Returns false,
+//    with nothing written, if zlib fails.
+//
+
+class framebuffer {
+   private:
+      int width_ {0};
+      int height_ {0};
+      vector<GLubyte> pixels;
+   public:
+      framebuffer() {}
+      framebuffer (int width, int height) { resize (width, height); }
+      void resize (int width, int height);
+      void clear (const rgbcolor& color);
+      int width() const { return width_; }
+      int height() const { return height_; }
+      GLubyte* row (int y) { return &pixels[size_t (y) * width_ * 3]; }
+      const GLubyte* row (int y) const {
+         return &pixels[size_t (y) * width_ * 3];
+      }
+      void write_ppm (ostream& out) const;
+      bool write_png (ostream& out) const;
+};
+
+//
+// raster_backend -
+//    CPU scanline rasterizer drawing into a framebuffer, so scenes
+//    can be rendered with no GL context or X display.  Polygons are
+//    filled with the nonzero winding rule, sampling at pixel centers.
+//    Drawing is clipped to the last region cleared.
+//    Wide lines are filled as quads.  Text is drawn from the runs in
+//    the glyph atlases, which do not need glutInit.
+// draw_instances -
+//    A geometry is scanned once into a coverage mask, a list of
+//    spans relative to its center, which is then stamped at each
+//    instance.  Masks are kept for one frame, by geometry id.  Text
+//    is drawn from a truncated origin, so any instance can use its
+//    mask; a polygon instance whose center is not on a whole pixel
+//    is scanned on its own instead.  So is every instance of a
+//    rotated or scaled run, from its triangles mapped once by the
+//    run's linear part.
+//
+
+struct raster_edge {
+   int ystart;
+   int yend;
+   GLfloat x;
+   GLfloat dxdy;
+   int winding;
+};
+
+struct coverage_span {
+   int y;
+   int x0;
+   int x1;
+};
+
+struct raster_stats {
+   size_t primitives {0};
+   size_t pixels {0};
+};
+
+class raster_backend: public render_backend {
+      friend class tiled_backend;
+   private:
+      framebuffer& fb;
+      rgbcolor background {64, 64, 64};
+      raster_stats stats_;
+      int clip_left {0};
+      int clip_bottom {0};
+      int clip_right {0};
+      int clip_top {0};
+      vector<raster_edge> edges;
+      vector<raster_edge*> active;
+      vector<pair<GLfloat,int>> crossings;
+      unordered_map<uint32_t,vector<coverage_span>> masks;
+      vertex_list shaped;
+      void span (int y, int x0, int x1, const rgbcolor& color);
+      template <typename emit_t>
+      void scan_polygon (const vertex* vertices, size_t count,
+                         const vertex& offset, int bottom, int top,
+                         emit_t emit);
+      void scan_polygon (const vertex* vertices, size_t count,
+                         const vertex& offset, const rgbcolor& color);
+      template <typename emit_t>
+      void scan_glyphs (const text_layout& layout, int xpos, int ypos,
+                        emit_t emit);
+      const vector<coverage_span>& mask (uint32_t geometry_id,
+                                         const scene_store::geometry&);
+      void stamp (const vector<coverage_span>& spans, int xpos,
+                  int ypos, const rgbcolor& color);
+   public:
+      raster_backend (framebuffer& fb);
+      void set_background (const rgbcolor& color) {
+         background = color;
+      }
+      const raster_stats& stats() const { return stats_; }
+      void reset_stats() { stats_ = raster_stats(); }
+      virtual void begin_frame (int width, int height) override;
+      virtual void clear_region (const bbox& region) override;
+      virtual void end_frame() override;
+      virtual void fill_polygon (const vertex* vertices, size_t count,
+                                 const vertex& offset,
+                                 const rgbcolor& color) override;
+      virtual void fill_triangles (const vertex* vertices, size_t count,
+                                   const vertex& offset,
+                                   const rgbcolor& color) override;
+      virtual void draw_lines (const vertex* vertices, size_t count,
+                               const vertex& offset, GLfloat width,
+                               const rgbcolor& color) override;
+      virtual void draw_glyphs (const text_layout& layout,
+                                const vertex& where,
+                                const rgbcolor& color) override;
+      virtual void draw_triangles (render_list& list, size_t first,
+                                   size_t count) override;
+      virtual bool draws_instances() const override { return true; }
+      virtual void draw_instances (uint32_t geometry_id,
+                                   const scene_store::geometry& info,
+                                   const transform2d& linear,
+                                   const vertex* centers,
+                                   const rgbcolor* colors,
+                                   size_t count) override;
+};
+
+//
+// tiled_backend -
+//    A raster_backend that draws each region as square tiles, aligned
+//    to multiples of tile_size from the window origin, on a work_pool.
+//    Every listed object is binned, in order, into each tile its
+//    bounds touch, so each tile is painted in the same order as the
+//    whole region would be.  Every pool worker has a raster_backend
+//    of its own on the shared framebuffer, and tiles never share a
+//    pixel, so workers need no locks while drawing.  Anything drawn
+//    outside draw_region, like the overlay, is drawn by this backend
+//    on the calling thread.  The stats include the workers'.
+//
+
+class tiled_backend: public raster_backend {
+   private:
+      int tile_size;
+      work_pool pool;
+      vector<unique_ptr<raster_backend>> workers;
+      vector<bbox> tiles;
+      vector<vector<size_t>> bins;
+   public:
+      static const int default_tile_size = 128;
+      tiled_backend (framebuffer& fb, size_t threads,
+                     int tile_size = default_tile_size);
+      size_t threads() const { return pool.size(); }
+      virtual void begin_frame (int width, int height) override;
+      virtual void draw_region (const bbox& region,
+                                const scene_store& scene,
+                                render_list& list,
+                                const vector<size_t>& visible) override;
+};
+
+#endif
+
@@ -0,0 +1,217 @@
+// $Id$
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <algorithm>
+#include <string>
+using namespace std;
+
+#include <GL/freeglut.h>
+
+#include "batch.h"
+#include "render.h"
+#include "shape.h"
+
+static gl_backend default_backend;
+thread_local render_backend* render::current = &default_backend;
+
+void render_backend::draw_region (const bbox& region,
+                                  const scene_store& scene,
+                                  render_list& list,
+                                  const vector<size_t>& visible) {
+   clear_region (region);
+   list.submit (scene, visible);
+}
+
+void render_backend::draw_instances (uint32_t,
+                                     const scene_store::geometry& info,
+                                     const transform2d& linear,
+                                     const vertex* centers,
+                                     const rgbcolor* colors,
+                                     size_t count) {
+   static vertex_list shaped;
+   static const vertex origin (0.0f, 0.0f);
+   bool moved_only = linear.is_translation();
+   for (size_t index = 0; index < count; ++index) {
+      if (info.kind == shape_kind::text) {
+         draw_glyphs (*info.layout, centers[index], colors[index]);
+         continue;
+      }
+      bool listed = not info.triangles.empty();
+      const vertex_list& local = listed ? info.triangles : info.outline;
+      const vertex* vertices = local.data();
+      vertex offset = centers[index];
+      if (not moved_only) {
+         transform2d xform = linear;
+         xform.offset = centers[index];
+         shaped.resize (local.size());
+         transform_vertices (xform, local.data(), local.size(),
+                             shaped.data());
+         vertices = shaped.data();
+         offset = origin;
+      }
+      if (listed) {
+         fill_triangles (vertices, local.size(), offset, colors[index]);
+      }else {
+         fill_polygon (vertices, local.size(), offset, colors[index]);
+      }
+   }
+}
+
+void render_backend::draw_text (void* glut_bitmap_font,
+                                const string& textdata,
+                                const vertex& where,
+                                const rgbcolor& color) {
+   draw_glyphs (glyph_cache::layout (glut_bitmap_font, textdata), where,
+                color);
+}
+
+bbox text_extent (void* glut_bitmap_font, const string& textdata) {
+   text_layout layout = glyph_cache::layout (glut_bitmap_font, textdata);
+   return bbox (layout.left, layout.bottom, layout.right, layout.top);
+}
+
+void gl_backend::begin_frame (int width_, int height_) {
+   width = width_;
+   height = height_;
+   glDrawBuffer (GL_BACK);
+   glEnable (GL_SCISSOR_TEST);
+}
+
+void gl_backend::clear_region (const bbox& region) {
+   glScissor (region.left, region.bottom, region.right - region.left,
+              region.top - region.bottom);
+   glClear (GL_COLOR_BUFFER_BIT);
+}
+
+void gl_backend::end_frame() {
+   glDisable (GL_SCISSOR_TEST);
+   glReadBuffer (GL_BACK);
+   glDrawBuffer (GL_FRONT);
+   glWindowPos2i (0, 0);
+   glCopyPixels (0, 0, width, height, GL_COLOR);
+   glDrawBuffer (GL_BACK);
+   glFlush();
+}
+
+void gl_backend::fill_polygon (const vertex* vertices, size_t count,
+                               const vertex& offset,
+                               const rgbcolor& color) {
+   glBegin (GL_POLYGON);
+   glColor3ubv (color.ubvec);
+   for (size_t index = 0; index < count; ++index) {
+      glVertex2f (vertices[index].xpos + offset.xpos,
+                  vertices[index].ypos + offset.ypos);
+   }
+   glEnd();
+}
+
+void gl_backend::fill_triangles (const vertex* vertices, size_t count,
+                                 const vertex& offset,
+                                 const rgbcolor& color) {
+   glPushMatrix();
+   glTranslatef (offset.xpos, offset.ypos, 0);
+   glColor3ubv (color.ubvec);
+   glEnableClientState (GL_VERTEX_ARRAY);
+   glVertexPointer (2, GL_FLOAT, 0, vertices);
+   glDrawArrays (GL_TRIANGLES, 0, count);
+   glDisableClientState (GL_VERTEX_ARRAY);
+   glPopMatrix();
+}
+
+void gl_backend::draw_lines (const vertex* vertices, size_t count,
+                             const vertex& offset, GLfloat width,
+                             const rgbcolor& color) {
+   glLineWidth (width);
+   glEnable (GL_LINE_SMOOTH);
+   glColor3ubv (color.ubvec);
+   glBegin (GL_LINES);
+   for (size_t index = 0; index < count; ++index) {
+      glVertex2f (vertices[index].xpos + offset.xpos,
+                  vertices[index].ypos + offset.ypos);
+   }
+   glEnd();
+}
+
+static void upload (const glyph_atlas& atlas) {
+   glGenTextures (1, &atlas.texture);
+   glBindTexture (GL_TEXTURE_2D, atlas.texture);
+   glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+   glTexImage2D (GL_TEXTURE_2D, 0, GL_ALPHA, atlas.width, atlas.height,
+                 0, GL_ALPHA, GL_UNSIGNED_BYTE, atlas.pixels.data());
+   glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void gl_backend::draw_glyphs (const text_layout& layout,
+                              const vertex& where,
+                              const rgbcolor& color) {
+   if (layout.glyphs.empty()) return;
+   const glyph_atlas& atlas = *layout.atlas;
+   if (atlas.texture == 0) upload (atlas);
+   glBindTexture (GL_TEXTURE_2D, atlas.texture);
+   glEnable (GL_TEXTURE_2D);
+   glTexEnvi (GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+   glEnable (GL_ALPHA_TEST);
+   glAlphaFunc (GL_GREATER, 0.5f);
+   glColor3ubv (color.ubvec);
+   int xorigin = where.xpos;
+   int yorigin = where.ypos;
+   GLfloat scale = 1.0f / atlas.width;
+   glBegin (GL_QUADS);
+   for (const placed_glyph& each: layout.glyphs) {
+      const glyph& cell = atlas.glyphs[each.code];
+      int left = xorigin + each.xpos;
+      int bottom = yorigin + each.ypos;
+      GLfloat sleft = cell.xpos * scale;
+      GLfloat sright = (cell.xpos + cell.width) * scale;
+      glTexCoord2f (sleft, 0);
+      glVertex2i (left, bottom);
+      glTexCoord2f (sright, 0);
+      glVertex2i (left + cell.width, bottom);
+      glTexCoord2f (sright, 1);
+      glVertex2i (left + cell.width, bottom + atlas.height);
+      glTexCoord2f (sleft, 1);
+      glVertex2i (left, bottom + atlas.height);
+   }
+   glEnd();
+   glDisable (GL_ALPHA_TEST);
+   glDisable (GL_TEXTURE_2D);
+   glBindTexture (GL_TEXTURE_2D, 0);
+}
+
+void gl_backend::draw_triangles (render_list& list, size_t first,
+                                 size_t count) {
+   const size_t vertex_bytes = sizeof (vertex) + sizeof (rgbcolor);
+   if (list.buffer_ == 0) glGenBuffers (1, &list.buffer_);
+   glBindBuffer (GL_ARRAY_BUFFER, list.buffer_);
+   size_t size = list.size();
+   if (list.rebuilt or list.buffer_size_ != size) {
+      glBufferData (GL_ARRAY_BUFFER, size * vertex_bytes, nullptr,
+                    GL_DYNAMIC_DRAW);
+      glBufferSubData (GL_ARRAY_BUFFER, 0, size * sizeof (vertex),
+                       list.vertices());
+      glBufferSubData (GL_ARRAY_BUFFER, size * sizeof (vertex),
+                       size * sizeof (rgbcolor), list.colors());
+      list.buffer_size_ = size;
+      list.rebuilt = false;
+   }else if (list.dirty_begin != list.dirty_end) {
+      glBufferSubData (GL_ARRAY_BUFFER,
+                       list.dirty_begin * sizeof (vertex),
+                       (list.dirty_end - list.dirty_begin)
+                             * sizeof (vertex),
+                       list.vertices() + list.dirty_begin);
+   }
+   list.dirty_begin = list.dirty_end = 0;
+   glEnableClientState (GL_VERTEX_ARRAY);
+   glEnableClientState (GL_COLOR_ARRAY);
+   glVertexPointer (2, GL_FLOAT, 0, nullptr);
+   glColorPointer (3, GL_UNSIGNED_BYTE, 0,
+                   reinterpret_cast<const GLvoid*>
+                         (size * sizeof (vertex)));
+   glDrawArrays (GL_TRIANGLES, first, count);
+   glDisableClientState (GL_COLOR_ARRAY);
+   glDisableClientState (GL_VERTEX_ARRAY);
+   glBindBuffer (GL_ARRAY_BUFFER, 0);
+}
+
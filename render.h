@@ -0,0 +1,165 @@
+// $Id$
+
+#ifndef __RENDER_H__
+#define __RENDER_H__
+
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <GL/freeglut.h>
+
+#include "rgbcolor.h"
+#include "scene.h"
+#include "shape.h"
+
+class render_list;
+
+//
+// render_backend -
+//    Abstract drawing surface.  The shape::draw and shape::border
+//    overrides never talk to GL directly, they go through whatever
+//    backend is current.  Coordinates are in window pixels with the
+//    origin at the bottom left, the same as the gluOrtho2D projection
+//    set up by window::reshape.  Vertex arrays are in shape-local
+//    coordinates and are translated by offset.
+// begin_frame -
+//    Start a frame.  Nothing is cleared, the previous frame's pixels
+//    are kept.
+// clear_region -
+//    Clear a window rectangle and restrict drawing to it, until the
+//    next clear_region or end_frame.
+// draw_region -
+//    Clear a region and draw the listed scene objects in it, in
+//    order, leaving drawing restricted to it as clear_region does.
+//    The default clears it and submits them through list.
+// end_frame -
+//    Finish a frame and present it.
+// fill_polygon -
+//    Fill a closed convex polygon, as GL_POLYGON would.
+// fill_triangles -
+//    Fill count/3 independent triangles, as GL_TRIANGLES would.  This
+//    is how polygons, which may be concave, are filled.
+// draw_lines -
+//    Draw count/2 independent segments, as GL_LINES would.
+// draw_text -
+//    Draw a string in one of the GLUT bitmap fonts, with its
+//    baseline origin at where.  The default lays it out and calls
+//    draw_glyphs.
+// draw_glyphs -
+//    Draw laid out text from its font's glyph atlas, from where
+//    truncated to a whole pixel, as glRasterPos2i would.
+// draw_triangles -
+//    Draw count vertices, starting at first, of a retained
+//    render_list as independent triangles.
+// draws_instances -
+//    True if the backend would rather be handed objects that share a
+//    geometry as one draw_instances call than as retained triangles.
+// draw_instances -
+//    Draw count copies of one scene geometry, in order, the i-th at
+//    centers[i] in colors[i], all rotated and scaled by linear, whose
+//    offset is zero.  The default draws each copy as
+//    scene_store::draw does.
+//
+
+class render_backend {
+   public:
+      virtual ~render_backend() {}
+      virtual void begin_frame (int width, int height) = 0;
+      virtual void clear_region (const bbox& region) = 0;
+      virtual void draw_region (const bbox& region,
+                                const scene_store& scene,
+                                render_list& list,
+                                const vector<size_t>& visible);
+      virtual void end_frame() = 0;
+      virtual void fill_polygon (const vertex* vertices, size_t count,
+                                 const vertex& offset,
+                                 const rgbcolor& color) = 0;
+      virtual void fill_triangles (const vertex* vertices, size_t count,
+                                   const vertex& offset,
+                                   const rgbcolor& color) = 0;
+      virtual void draw_lines (const vertex* vertices, size_t count,
+                               const vertex& offset, GLfloat width,
+                               const rgbcolor& color) = 0;
+      virtual void draw_text (void* glut_bitmap_font,
+                              const string& textdata,
+                              const vertex& where,
+                              const rgbcolor& color);
+      virtual void draw_glyphs (const text_layout& layout,
+                                const vertex& where,
+                                const rgbcolor& color) = 0;
+      virtual void draw_triangles (render_list& list, size_t first,
+                                   size_t count) = 0;
+      virtual bool draws_instances() const { return false; }
+      virtual void draw_instances (uint32_t geometry_id,
+                                   const scene_store::geometry& info,
+                                   const transform2d& linear,
+                                   const vertex* centers,
+                                   const rgbcolor* colors,
+                                   size_t count);
+};
+
+//
+// gl_backend -
+//    Immediate mode OpenGL, needs a current GLUT window.  A
+//    render_list is kept in a vertex buffer object, and only the
+//    range dirtied since the last frame is uploaded again.  The back
+//    buffer is never swapped, so it keeps the last frame.  Regions are
+//    scissored and redrawn there, and end_frame copies the back buffer
+//    to the front, which also repairs the window after an expose.
+//    Each font's glyph atlas is uploaded once as an alpha texture, and
+//    a string is drawn as one batch of textured quads, alpha tested so
+//    only the glyphs' pixels are written.
+//
+
+class gl_backend: public render_backend {
+   private:
+      int width {0};
+      int height {0};
+   public:
+      virtual void begin_frame (int width, int height) override;
+      virtual void clear_region (const bbox& region) override;
+      virtual void end_frame() override;
+      virtual void fill_polygon (const vertex* vertices, size_t count,
+                                 const vertex& offset,
+                                 const rgbcolor& color) override;
+      virtual void fill_triangles (const vertex* vertices, size_t count,
+                                   const vertex& offset,
+                                   const rgbcolor& color) override;
+      virtual void draw_lines (const vertex* vertices, size_t count,
+                               const vertex& offset, GLfloat width,
+                               const rgbcolor& color) override;
+      virtual void draw_glyphs (const text_layout& layout,
+                                const vertex& where,
+                                const rgbcolor& color) override;
+      virtual void draw_triangles (render_list& list, size_t first,
+                                   size_t count) override;
+};
+
+//
+// text_extent -
+//    Box around the ink of a string drawn with draw_text at the
+//    origin.  Text is drawn from an integer raster position, so the
+//    box is padded by a pixel to cover a truncated fractional origin.
+//
+
+bbox text_extent (void* glut_bitmap_font, const string& textdata);
+
+//
+// render -
+//    static class holding the current backend.  Defaults to GL.  Each
+//    thread has its own, so threads drawing parts of a frame can each
+//    draw through their own backend.
+//
+
+class render {
+   private:
+      static thread_local render_backend* current;
+   public:
+      render() = delete;
+      static render_backend& backend() { return *current; }
+      static void use (render_backend& backend) { current = &backend; }
+};
+
+#endif
+
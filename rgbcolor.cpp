@@ -1,11 +1,10 @@
 // $Id: rgbcolor.cpp,v 1.2 2016/07/30 22:27:52 akhatri Exp $
 
-#include <cctype>
+#include <cstdint>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
-#include <unordered_map>
 #include <vector>
 using namespace std;
 
@@ -13,20 +12,53 @@ using namespace std;
 
 #include "colors.cppgen"
 
-rgbcolor::rgbcolor (const string& name) {
-   auto entry = color_names.find (name);
-   if (entry != color_names.end()) {
-      *this = entry->second;
-   }else {
-      invalid_argument error ("rgbcolor::rgbcolor(" + name + ")");
-      if (name.size() != 8) throw error;
-      string prefix = name.substr (0, 2);
-      if (not (prefix == "0x" or prefix == "0X")) throw error;
-      for (size_t index = 0; index < 3; ++index) {
-         string hex = name.substr (index * 2 + 2, 2);
-         for (char digit: hex) if (not isxdigit(digit)) throw error;
-         ubvec[index] = stoul (hex, nullptr, 16);
-      }
+//
+// Every name in the table must find its own entry, so a generator
+// that disagrees with color_hash fails to compile.
+//
+static constexpr size_t color_slot (string_view name) {
+   int32_t displace = color_displace[color_hash (0, name)
+                                     % color_table_size];
+   if (displace < 0) return -1 - displace;
+   return color_hash (displace, name) % color_table_size;
+}
+
+static constexpr bool color_table_valid() {
+   for (size_t slot = 0; slot < color_table_size; ++slot) {
+      if (color_slot (color_table[slot].name) != slot) return false;
+   }
+   return true;
+}
+
+static_assert (color_table_valid(), "colors.cppgen is not a perfect hash");
+
+bool find_color (string_view name, rgbcolor& color) {
+   const color_entry& entry = color_table[color_slot (name)];
+   if (entry.name != name) return false;
+   color = rgbcolor (entry.red, entry.green, entry.blue);
+   return true;
+}
+
+static int hex_digit (char digit) {
+   if (digit >= '0' and digit <= '9') return digit - '0';
+   if (digit >= 'a' and digit <= 'f') return digit - 'a' + 10;
+   if (digit >= 'A' and digit <= 'F') return digit - 'A' + 10;
+   return -1;
+}
+
+rgbcolor::rgbcolor (string_view name) {
+   if (find_color (name, *this)) return;
+   bool valid = name.size() == 8 and name[0] == '0'
+            and (name[1] == 'x' or name[1] == 'X');
+   for (size_t index = 0; valid and index < 3; ++index) {
+      int high = hex_digit (name[index * 2 + 2]);
+      int low = hex_digit (name[index * 2 + 3]);
+      valid = high >= 0 and low >= 0;
+      ubvec[index] = high * 16 + low;
+   }
+   if (not valid) {
+      throw invalid_argument ("rgbcolor::rgbcolor(" + string (name)
+                              + ")");
    }
 }
 
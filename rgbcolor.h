@@ -4,7 +4,7 @@
 #define __RGBCOLOR_H__
 
 #include <string>
-#include <unordered_map>
+#include <string_view>
 using namespace std;
 
 #include <GL/freeglut.h>
@@ -21,14 +21,21 @@ struct rgbcolor {
    explicit rgbcolor(): red(0), green(0), blue(0) {}
    explicit rgbcolor (GLubyte red, GLubyte green, GLubyte blue):
                red(red), green(green), blue(blue) {}
-   explicit rgbcolor (const string&);
+   explicit rgbcolor (string_view);
    const GLubyte* ubvec3() { return ubvec; }
    operator string() const;
 };
 
 ostream& operator<< (ostream&, const rgbcolor&);
 
-extern const std::unordered_map<std::string,rgbcolor> color_names;
+//
+// find_color -
+//    Look up an X11 color name in the generated table, without
+//    allocating.  Returns false if the name is unknown.  The string
+//    constructor accepts these names or 0xRRGGBB.
+//
+
+bool find_color (string_view name, rgbcolor& color);
 
 #endif
 
@@ -0,0 +1,385 @@
+// $Id$
+
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <vector>
+using namespace std;
+
+#include "debug.h"
+#include "graphics.h"
+#include "profile.h"
+#include "render.h"
+#include "scene.h"
+#include "util.h"
+
+//
+// First sight of a shape: the only place the store looks at it
+// through its virtual interface.  Triangles are built in scratch and
+// copied, so the arena holds no grown-out copies.
+//
+uint32_t scene_store::intern (const shape_ptr& pshape) {
+   auto itor = geometry_index.find (pshape.get());
+   if (itor != geometry_index.end()) return itor->second;
+   static vertex_list scratch;
+   scratch.clear();
+   geometry info;
+   info.pshape = pshape;
+   info.bounds = pshape->bounds();
+   info.layout = nullptr;
+   info.class_id = profiler::class_id (*pshape);
+   if (auto shape_text = dynamic_cast<const text*> (pshape.get())) {
+      info.kind = shape_kind::text;
+      info.layout = &shape_text->get_layout();
+   }else if (auto shape_ellipse = dynamic_cast<const ellipse*>
+                                        (pshape.get())) {
+      info.kind = shape_kind::ellipse;
+      info.outline = shape_ellipse->get_outline();
+      shape_ellipse->tessellate (scratch);
+   }else {
+      const polygon& shape_polygon = dynamic_cast<const polygon&>
+                                           (*pshape);
+      info.kind = shape_kind::polygon;
+      info.outline = shape_polygon.get_vertices();
+      shape_polygon.tessellate (scratch);
+   }
+   info.triangles.assign (scratch.begin(), scratch.end());
+   uint32_t id = add_geometry (move (info));
+   geometry_index.emplace (pshape.get(), id);
+   DEBUGF ('s', "geometry " << id << ": " << *pshape);
+   return id;
+}
+
+//
+// A reused record is destroyed and made again rather than assigned,
+// since assignment would keep the old arrays' memory resource, and
+// the arena may have been switched off since.
+//
+uint32_t scene_store::add_geometry (geometry&& info) {
+   if (free_geometries.empty()) {
+      geometries.push_back (move (info));
+      geometry_uses.push_back (0);
+      return geometries.size() - 1;
+   }
+   uint32_t id = free_geometries.back();
+   free_geometries.pop_back();
+   geometries[id].~geometry();
+   new (&geometries[id]) geometry (move (info));
+   return id;
+}
+
+//
+// A scaled copy is found again by its base's id and its segments,
+// and holds the base, which rescale looks up by shape.  The arrays
+// are given back now; the record is rebuilt when its id is reused.
+//
+void scene_store::release (uint32_t id) {
+   if (--geometry_uses[id] != 0) return;
+   geometry& info = geometries[id];
+   auto base = geometry_index.find (info.pshape.get());
+   if (base->second == id) {
+      geometry_index.erase (base);
+   }else {
+      scaled_index.erase (uint64_t (base->second) << 32
+                          | info.outline.size());
+      release (base->second);
+   }
+   for (auto itor = strokes.begin(); itor != strokes.end();) {
+      if (itor->first >> 32 == id) {
+         itor = strokes.erase (itor);
+      }else {
+         ++itor;
+      }
+   }
+   DEBUGF ('s', "geometry " << id << " dropped");
+   info.pshape.reset();
+   info.layout = nullptr;
+   info.outline.clear();
+   info.outline.shrink_to_fit();
+   info.triangles.clear();
+   info.triangles.shrink_to_fit();
+   free_geometries.push_back (id);
+}
+
+size_t scene_store::push_back (const object& obj) {
+   size_t slot = size();
+   uint32_t id = intern (obj.pshape);
+   shape_kind kind = geometries[id].kind;
+   xpos_.push_back (obj.center.xpos);
+   ypos_.push_back (obj.center.ypos);
+   colors_.push_back (obj.color);
+   move_by_.push_back (obj.move_by);
+   border_widths_.push_back (obj.border_width);
+   border_colors_.push_back (obj.border_color);
+   angles_.push_back (0);
+   xscales_.push_back (1);
+   yscales_.push_back (1);
+   kinds_.push_back (kind);
+   geometry_ids.push_back (id);
+   hold (id);
+   if (not spans_.empty() and spans_.back().kind == kind) {
+      ++spans_.back().count;
+   }else {
+      spans_.push_back ({kind, slot, 1});
+   }
+   return slot;
+}
+
+void scene_store::assign (size_t slot, const object& obj) {
+   uint32_t id = intern (obj.pshape);
+   shape_kind kind = geometries[id].kind;
+   if (kind != kinds_[slot]) spans_stale = true;
+   xpos_[slot] = obj.center.xpos;
+   ypos_[slot] = obj.center.ypos;
+   colors_[slot] = obj.color;
+   move_by_[slot] = obj.move_by;
+   border_widths_[slot] = obj.border_width;
+   border_colors_[slot] = obj.border_color;
+   angles_[slot] = 0;
+   xscales_[slot] = 1;
+   yscales_[slot] = 1;
+   kinds_[slot] = kind;
+   hold (id);
+   release (geometry_ids[slot]);
+   geometry_ids[slot] = id;
+}
+
+void scene_store::truncate (size_t count) {
+   if (count >= size()) return;
+   for (size_t slot = count; slot < size(); ++slot) {
+      release (geometry_ids[slot]);
+   }
+   xpos_.resize (count);
+   ypos_.resize (count);
+   colors_.resize (count);
+   move_by_.resize (count);
+   border_widths_.resize (count);
+   border_colors_.resize (count);
+   angles_.resize (count);
+   xscales_.resize (count);
+   yscales_.resize (count);
+   kinds_.resize (count);
+   geometry_ids.resize (count);
+   while (not spans_.empty() and spans_.back().first >= count) {
+      spans_.pop_back();
+   }
+   if (not spans_.empty()) {
+      span& last = spans_.back();
+      last.count = min (last.count, count - last.first);
+   }
+}
+
+const vector<scene_store::span>& scene_store::spans() const {
+   if (spans_stale) {
+      spans_.clear();
+      for (size_t slot = 0; slot < size(); ++slot) {
+         if (not spans_.empty() and spans_.back().kind == kinds_[slot]) {
+            ++spans_.back().count;
+         }else {
+            spans_.push_back ({kinds_[slot], slot, 1});
+         }
+      }
+      spans_stale = false;
+   }
+   return spans_;
+}
+
+//
+// Each column is copied whole; only the geometry ids and spans need
+// a pass per object, and each distinct shape is interned once.
+// Returns the first new slot.
+//
+size_t scene_store::append (const vector<shape_ptr>& shapes,
+                            const scene_columns& columns) {
+   size_t first = size();
+   size_t count = columns.count;
+   vector<uint32_t> ids (shapes.size(), UINT32_MAX);
+   auto copy = [count] (auto& into, const auto* from) {
+      into.insert (into.end(), from, from + count);
+   };
+   copy (xpos_, columns.xpos);
+   copy (ypos_, columns.ypos);
+   copy (colors_, columns.colors);
+   copy (move_by_, columns.move_by);
+   copy (border_widths_, columns.border_widths);
+   copy (border_colors_, columns.border_colors);
+   copy (angles_, columns.angles);
+   copy (xscales_, columns.xscales);
+   copy (yscales_, columns.yscales);
+   kinds_.reserve (first + count);
+   geometry_ids.reserve (first + count);
+   for (size_t index = 0; index < count; ++index) {
+      uint32_t& id = ids[columns.shapes[index]];
+      if (id == UINT32_MAX) id = intern (shapes[columns.shapes[index]]);
+      shape_kind kind = geometries[id].kind;
+      kinds_.push_back (kind);
+      geometry_ids.push_back (id);
+      hold (id);
+      if (not spans_.empty() and spans_.back().kind == kind) {
+         ++spans_.back().count;
+      }else {
+         spans_.push_back ({kind, first + index, 1});
+      }
+      if (transformed (first + index)) rescale (first + index);
+   }
+   return first;
+}
+
+void scene_store::advance (size_t first, size_t last,
+                           const GLfloat* xvelocity,
+                           const GLfloat* yvelocity, GLfloat seconds) {
+   GLfloat* __restrict xpos = xpos_.data();
+   GLfloat* __restrict ypos = ypos_.data();
+   for (size_t slot = first; slot < last; ++slot) {
+      xpos[slot] += xvelocity[slot] * seconds;
+      ypos[slot] += yvelocity[slot] * seconds;
+   }
+}
+
+void scene_store::clear() {
+   xpos_.clear();
+   ypos_.clear();
+   colors_.clear();
+   move_by_.clear();
+   border_widths_.clear();
+   border_colors_.clear();
+   angles_.clear();
+   xscales_.clear();
+   yscales_.clear();
+   kinds_.clear();
+   geometry_ids.clear();
+   geometries.clear();
+   geometry_uses.clear();
+   free_geometries.clear();
+   geometry_index.clear();
+   scaled_index.clear();
+   spans_.clear();
+   spans_stale = false;
+   strokes.clear();
+}
+
+void scene_store::set_transform (size_t slot, GLfloat angle,
+                                 GLfloat xscale, GLfloat yscale) {
+   angles_[slot] = angle;
+   xscales_[slot] = xscale;
+   yscales_[slot] = yscale;
+   rescale (slot);
+}
+
+//
+// Point an ellipse's slot at the geometry for its scale: the shape's
+// own when that needs as many segments, else one tessellated for
+// the scaled radius, made the first time it is needed.
+//
+void scene_store::rescale (size_t slot) {
+   if (kinds_[slot] != shape_kind::ellipse) return;
+   shape_ptr pshape = geometry_of (slot).pshape;
+   const ellipse& shape_ellipse = dynamic_cast<const ellipse&> (*pshape);
+   uint32_t id = geometry_index.at (pshape.get());
+   GLfloat scale = max (fabs (xscales_[slot]), fabs (yscales_[slot]));
+   size_t segments = shape_ellipse.segments_at (scale);
+   if (segments != geometries[id].outline.size()) {
+      uint64_t key = uint64_t (id) << 32 | segments;
+      auto itor = scaled_index.find (key);
+      if (itor != scaled_index.end()) {
+         id = itor->second;
+      }else {
+         geometry info;
+         info.pshape = pshape;
+         info.kind = shape_kind::ellipse;
+         info.bounds = geometries[id].bounds;
+         info.layout = nullptr;
+         info.class_id = geometries[id].class_id;
+         shape_ellipse.tessellate_at (scale, info.outline,
+                                      info.triangles);
+         hold (id);
+         id = add_geometry (move (info));
+         scaled_index.emplace (key, id);
+      }
+   }
+   hold (id);
+   release (geometry_ids[slot]);
+   geometry_ids[slot] = id;
+}
+
+size_t scene_store::vertex_count (size_t slot) const {
+   const geometry& info = geometry_of (slot);
+   if (info.kind == shape_kind::text) return 4 * info.layout->glyphs.size();
+   if (not info.triangles.empty()) return info.triangles.size();
+   return info.outline.size();
+}
+
+void scene_store::draw (size_t slot) const {
+   const geometry& info = geometry_of (slot);
+   render_backend& backend = render::backend();
+   if (info.kind == shape_kind::text) {
+      backend.draw_glyphs (*info.layout, center (slot), colors_[slot]);
+      return;
+   }
+   bool listed = not info.triangles.empty();
+   const vertex_list& local = listed ? info.triangles : info.outline;
+   const vertex* vertices = local.data();
+   vertex offset = center (slot);
+   if (transformed (slot)) {
+      static vertex_list world;
+      world.resize (local.size());
+      transform_vertices (transform (slot), local.data(), local.size(),
+                          world.data());
+      vertices = world.data();
+      offset = vertex (0.0f, 0.0f);
+   }
+   if (listed) {
+      backend.fill_triangles (vertices, local.size(), offset,
+                              colors_[slot]);
+   }else {
+      backend.fill_polygon (vertices, local.size(), offset,
+                            colors_[slot]);
+   }
+}
+
+static void stroke_geometry (const scene_store::geometry& info,
+                             const transform2d& linear, GLfloat width,
+                             scene_store::stroke& into) {
+   vertex_list outline = info.outline;
+   if (info.kind == shape_kind::text) {
+      const bbox& box = info.bounds;
+      outline = {{box.left, box.bottom}, {box.left, box.top},
+                 {box.right, box.top}, {box.right, box.bottom}};
+   }else if (not linear.is_translation()) {
+      transform_vertices (linear, info.outline.data(), outline.size(),
+                          outline.data());
+   }
+   into.triangles.clear();
+   stroke_outline (outline.data(), outline.size(), width, into.triangles);
+   into.bounds = bbox();
+   for (const vertex& vert: into.triangles) into.bounds.expand (vert);
+}
+
+const scene_store::stroke& scene_store::border_stroke (size_t slot)
+      const {
+   const geometry& info = geometry_of (slot);
+   GLfloat width = border_widths_[slot];
+   if (info.kind != shape_kind::text and transformed (slot)) {
+      static stroke mapped;
+      transform2d linear = transform (slot);
+      linear.offset = vertex (0.0f, 0.0f);
+      stroke_geometry (info, linear, width, mapped);
+      return mapped;
+   }
+   uint32_t width_bits;
+   memcpy (&width_bits, &width, sizeof width_bits);
+   uint64_t key = uint64_t (geometry_ids[slot]) << 32 | width_bits;
+   auto found = strokes.find (key);
+   if (found != strokes.end()) return found->second;
+   stroke& made = strokes[key];
+   stroke_geometry (info, transform2d(), width, made);
+   return made;
+}
+
+void scene_store::draw_border (size_t slot) const {
+   const stroke& band = border_stroke (slot);
+   render::backend().fill_triangles (band.triangles.data(),
+                                     band.triangles.size(), center (slot),
+                                     border_colors_[slot]);
+}
+
@@ -0,0 +1,225 @@
+// $Id$
+
+#ifndef __SCENE_H__
+#define __SCENE_H__
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+#include <GL/freeglut.h>
+
+#include "arena.h"
+#include "rgbcolor.h"
+#include "shape.h"
+#include "transform.h"
+
+class object;
+
+//
+// scene_columns -
+//    Objects laid out column by column, as scene_store keeps them,
+//    for appending many at once.  shapes are indices into a table
+//    of shape pointers given with the columns.
+//
+
+struct scene_columns {
+   size_t count;
+   const uint32_t* shapes;
+   const GLfloat* xpos;
+   const GLfloat* ypos;
+   const rgbcolor* colors;
+   const GLfloat* move_by;
+   const GLfloat* border_widths;
+   const rgbcolor* border_colors;
+   const GLfloat* angles;
+   const GLfloat* xscales;
+   const GLfloat* yscales;
+};
+
+//
+// scene_store -
+//    Structure-of-arrays store for the objects in the window.  The
+//    per-object fields an object holds (center, color, move_by and
+//    border) each live in their own contiguous array indexed by slot,
+//    and the shape is reduced to a small geometry id and a kind tag.
+//    Each distinct shape is looked at once, when it is first pushed,
+//    and its kind, local bounds, outline and triangles are kept in a
+//    geometry record, so no per-object loop needs a virtual call or
+//    a shared_ptr.  Its outline and triangles are allocated from
+//    shape_arena, like the shape's own arrays.  Geometries count the
+//    slots, and scaled copies, that use them; one no longer used is
+//    dropped with its strokes and its shape let go, and its id is
+//    given to the next new geometry.  Backends key nothing by id
+//    from one frame to the next, so reuse is safe between frames.
+// draw_border -
+//    Fill the object's border, stroked from its geometry's outline,
+//    or for text the box around it.  Strokes are kept by geometry and
+//    border width, so drawing a border again submits the same
+//    triangles; an object that is rotated or scaled strokes its
+//    mapped outline instead, so its border keeps its width.
+//    border_bounds is the box around what draw_border fills.
+// transform -
+//    Each object also has a rotation, in radians, and a scale along
+//    each of its shape's axes, which with its center make the map
+//    from the geometry's local coordinates to the window.  Bounds
+//    follow it.  Text is drawn from bitmap fonts and is never rotated
+//    or scaled.  A scaled ellipse is given a geometry of its own,
+//    tessellated for its scaled radius, shared by every object with
+//    the same shape and segment count.
+// spans -
+//    Slots grouped into maximal runs of the same shape kind, in slot
+//    order.  Draw loops walk the spans and switch on the kind once per
+//    run, which keeps painter's order.  After assign changes a slot's
+//    kind they are found again, once, when next asked for.
+// assign -
+//    Replace everything about the object in slot, as push_back would
+//    have set it.
+// truncate -
+//    Drop the objects from slot count on, and any geometries only
+//    they used.
+// vertex_count -
+//    Vertices drawing the object submits: its triangles, its outline
+//    if it has none, or a quad for each glyph of text.
+// advance -
+//    Move slots first up to last by their velocities times seconds,
+//    in one loop over the position columns that the compiler can
+//    vectorize.  Different ranges may be advanced concurrently.
+//
+
+enum class shape_kind: uint8_t {polygon, ellipse, text};
+
+class scene_store {
+   public:
+      struct geometry {
+         shape_ptr pshape;
+         shape_kind kind;
+         bbox bounds;             // local
+         vertex_list outline;     // local, closed, empty for text
+         vertex_list triangles;   // local, empty for text
+         const text_layout* layout;  // text only, in pshape
+         uint16_t class_id;       // for the profiler
+         geometry(): outline (shape_arena::resource()),
+                     triangles (shape_arena::resource()) {}
+      };
+      struct span {
+         shape_kind kind;
+         size_t first;
+         size_t count;
+      };
+      struct stroke {
+         vertex_list triangles;   // local
+         bbox bounds;             // local
+      };
+   private:
+      vector<GLfloat> xpos_;
+      vector<GLfloat> ypos_;
+      vector<rgbcolor> colors_;
+      vector<GLfloat> move_by_;
+      vector<GLfloat> border_widths_;
+      vector<rgbcolor> border_colors_;
+      vector<GLfloat> angles_;
+      vector<GLfloat> xscales_;
+      vector<GLfloat> yscales_;
+      vector<shape_kind> kinds_;
+      vector<uint32_t> geometry_ids;
+      vector<geometry> geometries;
+      vector<uint32_t> geometry_uses;     // by id
+      vector<uint32_t> free_geometries;   // ids to reuse
+      unordered_map<const shape*,uint32_t> geometry_index;
+      unordered_map<uint64_t,uint32_t> scaled_index;  // id, segments
+      mutable vector<span> spans_;
+      mutable bool spans_stale {false};
+      mutable unordered_map<uint64_t,stroke> strokes;
+      uint32_t intern (const shape_ptr& pshape);
+      uint32_t add_geometry (geometry&& info);
+      void hold (uint32_t id) { ++geometry_uses[id]; }
+      void release (uint32_t id);
+      void rescale (size_t slot);
+      const stroke& border_stroke (size_t slot) const;
+   public:
+      size_t push_back (const object& obj);
+      size_t append (const vector<shape_ptr>& shapes,
+                     const scene_columns& columns);
+      void assign (size_t slot, const object& obj);
+      void truncate (size_t count);
+      void clear();
+      size_t size() const { return kinds_.size(); }
+      bool empty() const { return kinds_.empty(); }
+
+      const GLfloat* xpos() const { return xpos_.data(); }
+      const GLfloat* ypos() const { return ypos_.data(); }
+      const rgbcolor* colors() const { return colors_.data(); }
+      const GLfloat* angles() const { return angles_.data(); }
+      const GLfloat* xscales() const { return xscales_.data(); }
+      const GLfloat* yscales() const { return yscales_.data(); }
+      const shape_kind* kinds() const { return kinds_.data(); }
+      const vector<span>& spans() const;
+
+      vertex center (size_t slot) const {
+         return vertex (xpos_[slot], ypos_[slot]);
+      }
+      void set_center (size_t slot, const vertex& center) {
+         xpos_[slot] = center.xpos;
+         ypos_[slot] = center.ypos;
+      }
+      void advance (size_t first, size_t last, const GLfloat* xvelocity,
+                    const GLfloat* yvelocity, GLfloat seconds);
+      const rgbcolor& color (size_t slot) const { return colors_[slot]; }
+      GLfloat move_by (size_t slot) const { return move_by_[slot]; }
+      void set_move_by (size_t slot, GLfloat by) { move_by_[slot] = by; }
+      GLfloat border_width (size_t slot) const {
+         return border_widths_[slot];
+      }
+      const rgbcolor& border_color (size_t slot) const {
+         return border_colors_[slot];
+      }
+      void set_border (size_t slot, GLfloat width,
+                       const rgbcolor& color) {
+         border_widths_[slot] = width;
+         border_colors_[slot] = color;
+      }
+      bool transformed (size_t slot) const {
+         return angles_[slot] != 0 or xscales_[slot] != 1
+             or yscales_[slot] != 1;
+      }
+      transform2d transform (size_t slot) const {
+         if (not transformed (slot)) {
+            transform2d xform;
+            xform.offset = center (slot);
+            return xform;
+         }
+         return transform2d (center (slot), angles_[slot],
+                             xscales_[slot], yscales_[slot]);
+      }
+      void set_transform (size_t slot, GLfloat angle, GLfloat xscale,
+                          GLfloat yscale);
+      uint32_t geometry_id (size_t slot) const {
+         return geometry_ids[slot];
+      }
+      const geometry& geometry_of (size_t slot) const {
+         return geometries[geometry_ids[slot]];
+      }
+      bbox bounds (size_t slot) const {
+         const geometry& info = geometry_of (slot);
+         if (info.kind == shape_kind::text or not transformed (slot)) {
+            return info.bounds.offset (center (slot));
+         }
+         return transform (slot).apply (info.bounds);
+      }
+      size_t num_geometries() const {
+         return geometries.size() - free_geometries.size();
+      }
+      size_t vertex_count (size_t slot) const;
+
+      void draw (size_t slot) const;
+      void draw_border (size_t slot) const;
+      bbox border_bounds (size_t slot) const {
+         return border_stroke (slot).bounds.offset (center (slot));
+      }
+};
+
+#endif
+
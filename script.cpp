@@ -0,0 +1,139 @@
+// $Id$
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "script.h"
+#include "util.h"
+
+script_source::script_source (const string& filename, bool map) {
+   int fd = open (filename.c_str(), O_RDONLY);
+   if (fd < 0) {
+      failed = true;
+      return;
+   }
+   struct stat status;
+   if (map and fstat (fd, &status) == 0 and S_ISREG (status.st_mode)
+       and status.st_size > 0) {
+      size = status.st_size;
+      mapping = mmap (nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping == MAP_FAILED) {
+         mapping = nullptr;
+         size = 0;
+      }else {
+         madvise (mapping, size, MADV_SEQUENTIAL);
+         data = static_cast<const char*> (mapping);
+      }
+   }
+   if (mapping == nullptr) {
+      char block[65536];
+      for (;;) {
+         ssize_t bytes = read (fd, block, sizeof block);
+         if (bytes < 0 and errno == EINTR) continue;
+         if (bytes <= 0) break;
+         buffer.append (block, bytes);
+      }
+      data = buffer.data();
+      size = buffer.size();
+   }
+   close (fd);
+   DEBUGF ('m', filename << ": " << size << " bytes"
+           << (mapping ? ", mapped" : ""));
+}
+
+script_source::script_source (istream& in):
+               buffer (istreambuf_iterator<char> (in),
+                       istreambuf_iterator<char>()) {
+   data = buffer.data();
+   size = buffer.size();
+}
+
+script_source::~script_source() {
+   if (mapping != nullptr) munmap (mapping, size);
+}
+
+//
+// A backslash is a line continuation if it is the last character on
+// its line, or of the text.
+//
+static inline bool continuation (const char* pos, const char* end) {
+   return *pos == '\\' and (pos + 1 == end or pos[1] == '\n');
+}
+
+bool script_scanner::next (vector<string_view>& words,
+                           int& command_linenr) {
+   while (pos < end) {
+      words.clear();
+      command_linenr = linenr;
+      while (pos < end) {
+         char byte = *pos;
+         if (byte == '\n') {
+            ++pos;
+            ++linenr;
+            break;
+         }
+         if (byte == ' ' or byte == '\t') {
+            ++pos;
+         }else if (continuation (pos, end)) {
+            ++pos;
+            if (pos < end) {
+               ++pos;
+               ++linenr;
+            }
+         }else {
+            const char* start = pos;
+            while (pos < end and *pos != ' ' and *pos != '\t'
+                   and *pos != '\n' and not continuation (pos, end)) {
+               ++pos;
+            }
+            words.emplace_back (start, pos - start);
+         }
+      }
+      if (not words.empty() and words.front()[0] != '#') return true;
+   }
+   return false;
+}
+
+vector<script_chunk> split_script (string_view text, size_t parts) {
+   vector<script_chunk> chunks;
+   const char* begin = text.data();
+   const char* end = begin + text.size();
+   size_t target = text.size() / max<size_t> (parts, 1);
+   const char* start = begin;
+   int linenr = 1;
+   while (start < end) {
+      const char* cut = end;
+      if (chunks.size() + 1 < parts
+          and size_t (end - start) > target) {
+         cut = start + target;
+         for (;;) {
+            cut = static_cast<const char*> (memchr (cut, '\n',
+                                                    end - cut));
+            if (cut == nullptr) {
+               cut = end;
+               break;
+            }
+            ++cut;
+            if (cut - begin < 2 or cut[-2] != '\\') break;
+         }
+      }
+      string_view piece (start, cut - start);
+      chunks.push_back ({piece, linenr});
+      linenr += count (piece.begin(), piece.end(), '\n');
+      start = cut;
+   }
+   DEBUGF ('m', chunks.size() << " chunks of " << text.size()
+           << " bytes");
+   return chunks;
+}
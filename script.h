@@ -0,0 +1,80 @@
+// $Id$
+
+#ifndef __SCRIPT_H__
+#define __SCRIPT_H__
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+//
+// script_source -
+//    The whole text of an input script.  A regular file is mapped
+//    into memory read-only; anything else, such as cin or a pipe, is
+//    read into a buffer.  So is a regular file when map is false, as
+//    for a watched script that may be truncated while it is scanned,
+//    which would fault on a mapping.  fail() is true if the file
+//    could not be opened, with errno set.
+//
+
+class script_source {
+   private:
+      const char* data {nullptr};
+      size_t size {0};
+      void* mapping {nullptr};
+      string buffer;
+      bool failed {false};
+   public:
+      explicit script_source (const string& filename, bool map = true);
+      explicit script_source (istream& in);
+      script_source (const script_source&) = delete;
+      script_source& operator= (const script_source&) = delete;
+      ~script_source();
+      bool fail() const { return failed; }
+      string_view text() const { return string_view (data, size); }
+};
+
+//
+// script_scanner -
+//    Splits script text into commands, one per logical line, without
+//    copying.  Words are views into the text, separated by blanks and
+//    tabs.  A backslash at the end of a line acts as a blank and joins
+//    the next line to this one.  Blank lines and lines whose first
+//    word starts with '#' are skipped.  A scanner over a chunk of a
+//    script is given the line number the chunk starts on.
+// next -
+//    Fill words with the next command and linenr with the line it
+//    starts on.  Returns false at the end of the text.
+//
+
+class script_scanner {
+   private:
+      const char* pos;
+      const char* end;
+      int linenr {1};
+   public:
+      explicit script_scanner (string_view text, int first_linenr = 1):
+               pos(text.data()), end(text.data() + text.size()),
+               linenr(first_linenr) {}
+      bool next (vector<string_view>& words, int& command_linenr);
+};
+
+//
+// script_chunk, split_script -
+//    Cut a script into at most parts chunks of about equal size for
+//    scanning in parallel.  Cuts are made only at the start of a line
+//    whose predecessor is not continued, so every command lies wholly
+//    in one chunk.  Chunks are in script order.
+//
+
+struct script_chunk {
+   string_view text;
+   int linenr;
+};
+
+vector<script_chunk> split_script (string_view text, size_t parts);
+
+#endif
+
@@ -1,10 +1,14 @@
 // $Id: shape.cpp,v 1.2 2016/07/30 22:27:52 akhatri Exp $
 
+#include <algorithm>
 #include <typeinfo>
 #include <unordered_map>
 using namespace std;
 
+#include "arena.h"
+#include "render.h"
 #include "shape.h"
+#include "trace.h"
 #include "util.h"
 
 static unordered_map<void*,string> fontname {
@@ -32,18 +36,81 @@ ostream& operator<< (ostream& out, const vertex& where) {
    return out;
 }
 
+void bbox::expand (const vertex& where) {
+   left = min (left, where.xpos);
+   bottom = min (bottom, where.ypos);
+   right = max (right, where.xpos);
+   top = max (top, where.ypos);
+}
+
+void bbox::expand (const bbox& box) {
+   left = min (left, box.left);
+   bottom = min (bottom, box.bottom);
+   right = max (right, box.right);
+   top = max (top, box.top);
+}
+
 shape::shape() {
    DEBUGF ('c', this);
 }
 
 text::text (void* glut_bitmap_font, const string& textdata):
-      glut_bitmap_font(glut_bitmap_font), textdata(textdata) {
+      glut_bitmap_font(glut_bitmap_font), textdata(textdata),
+      layout(glyph_cache::layout (glut_bitmap_font, textdata)) {
    DEBUGF ('c', this);
 }
 
+//
+// Unit circle sampled at the largest segment count an ellipse may
+// use.  Every smaller count is a power of two, so its vertices are
+// a strided subset of this one table.
+//
+static const size_t max_segments = 4096;
+static const size_t min_segments = 8;
+
+static const vertex_list& unit_circle() {
+   static const vertex_list table = [] {
+      vertex_list points;
+      points.reserve (max_segments);
+      for (size_t index = 0; index < max_segments; ++index) {
+         double angle = 2 * M_PI * index / max_segments;
+         points.push_back (vertex (sin (angle), cos (angle)));
+      }
+      return points;
+   }();
+   return table;
+}
+
+static size_t ellipse_segments (GLfloat radius) {
+   const double tolerance = 0.25;
+   if (radius <= tolerance) return min_segments;
+   double step = 2 * acos (1 - tolerance / radius);
+   size_t wanted = ceil (2 * M_PI / step);
+   size_t segments = min_segments;
+   while (segments < wanted and segments < max_segments) segments *= 2;
+   return segments;
+}
+
 ellipse::ellipse (GLfloat width, GLfloat height):
-dimension ({width, height}) {
+dimension ({width, height}), outline (shape_arena::resource()) {
    DEBUGF ('c', this);
+   sample (segments_at (1), outline);
+   TRACE ('c', "ellipse", outline.size());
+}
+
+size_t ellipse::segments_at (GLfloat scale) const {
+   return ellipse_segments (max (fabs (dimension.xpos),
+                                 fabs (dimension.ypos)) * fabs (scale));
+}
+
+void ellipse::sample (size_t segments, vertex_list& into) const {
+   const vertex_list& unit = unit_circle();
+   size_t stride = max_segments / segments;
+   into.reserve (into.size() + segments);
+   for (size_t index = 0; index < max_segments; index += stride) {
+      into.push_back (vertex (unit[index].xpos * dimension.xpos,
+                              unit[index].ypos * dimension.ypos));
+   }
 }
 
 circle::circle(GLfloat diameter): ellipse(diameter, diameter) {
@@ -55,8 +122,91 @@ void circle::draw(const vertex& center, const rgbcolor& color) const {
     return ellipse::draw(center, color);
 }
 
-polygon::polygon (const vertex_list& vertices): vertices(vertices) {
+//
+// Twice the signed area of the triangle a, b, c: positive if it turns
+// counterclockwise.
+//
+static double turn (const vertex& a, const vertex& b, const vertex& c) {
+   return (double (b.xpos) - a.xpos) * (double (c.ypos) - a.ypos)
+        - (double (b.ypos) - a.ypos) * (double (c.xpos) - a.xpos);
+}
+
+//
+// Ear clipping.  The outline is walked counterclockwise, whichever way
+// it was given, and a vertex is cut off with its neighbors when it is
+// convex and no other remaining vertex lies in that triangle.  Every
+// simple polygon has such an ear.  An outline that crosses itself may
+// run out of ears, and then the next vertex is cut anyway, so every
+// outline gets count - 2 triangles.
+//
+static index_list triangulate (const vertex_list& points) {
+   index_list indices (shape_arena::resource());
+   size_t count = points.size();
+   if (count < 3) return indices;
+   indices.reserve ((count - 2) * 3);
+   double area = 0;
+   for (size_t i = 0; i < count; ++i) {
+      const vertex& from = points[i];
+      const vertex& to = points[(i + 1) % count];
+      area += double (from.xpos) * to.ypos - double (to.xpos) * from.ypos;
+   }
+   static thread_local vector<uint32_t> ring;
+   ring.resize (count);
+   for (size_t i = 0; i < count; ++i) {
+      ring[i] = area < 0 ? count - 1 - i : i;
+   }
+   size_t at = 0;
+   size_t misses = 0;
+   while (ring.size() > 3) {
+      size_t size = ring.size();
+      at %= size;
+      uint32_t prev = ring[(at + size - 1) % size];
+      uint32_t here = ring[at];
+      uint32_t next = ring[(at + 1) % size];
+      const vertex& a = points[prev];
+      const vertex& b = points[here];
+      const vertex& c = points[next];
+      bool ear = turn (a, b, c) > 0;
+      for (size_t i = 0; ear and i < size; ++i) {
+         uint32_t other = ring[i];
+         if (other == prev or other == here or other == next) continue;
+         const vertex& p = points[other];
+         ear = not (turn (a, b, p) >= 0 and turn (b, c, p) >= 0
+                    and turn (c, a, p) >= 0);
+      }
+      if (ear or misses >= size) {
+         indices.insert (indices.end(), {prev, here, next});
+         ring.erase (ring.begin() + at);
+         if (at > 0) --at;
+         misses = 0;
+      }else {
+         ++at;
+         ++misses;
+      }
+   }
+   indices.insert (indices.end(), ring.begin(), ring.end());
+   return indices;
+}
+
+polygon::polygon (const vertex_list& vertices_):
+         vertices(vertices_, shape_arena::resource()),
+         indices(triangulate (vertices)) {
    DEBUGF ('c', this);
+   TRACE ('c', "polygon", vertices.size());
+}
+
+polygon::polygon (vertex_list&& vertices_):
+         vertices(move (vertices_), shape_arena::resource()),
+         indices(triangulate (vertices)) {
+   DEBUGF ('c', this);
+   TRACE ('c', "polygon", vertices.size());
+}
+
+polygon::polygon (initializer_list<vertex> vertices_):
+         vertices(vertices_, shape_arena::resource()),
+         indices(triangulate (vertices)) {
+   DEBUGF ('c', this);
+   TRACE ('c', "polygon", vertices.size());
 }
 
 rectangle::rectangle (GLfloat width, GLfloat height):
@@ -65,32 +215,10 @@ rectangle::rectangle (GLfloat width, GLfloat height):
    DEBUGF ('c', this << "(" << width << "," << height << ")");
 }
 
+// Top, left, bottom and right corners.
 diamond::diamond(const GLfloat width, const GLfloat height):
-    polygon(([] (GLfloat w, GLfloat h) -> vertex_list {
-        vertex_list vs;
-
-        //top of diamond
-        GLfloat x0 = 0;
-        GLfloat y0 = (h / 2);
-        vs.push_back(vertex{x0, y0});
-
-        //left of diamond
-        GLfloat x2 = - (w / 2);
-        GLfloat y2 = 0;
-        vs.push_back(vertex{x2, y2});
-
-        //bottom of diamond
-        GLfloat x1 = 0;
-        GLfloat y1 = - (h / 2);
-        vs.push_back(vertex{x1, y1});
-
-        //right of diamond
-        GLfloat x3 = (w / 2);
-        GLfloat y3 = 0;
-        vs.push_back(vertex{x3, y3});
-
-        return vs;
-    })(width, height)) {
+    polygon({{0.0f, height / 2}, {-(width / 2), 0.0f},
+             {0.0f, -(height / 2)}, {width / 2, 0.0f}}) {
 }
 
 square::square (GLfloat width): rectangle (width, width) {
@@ -116,42 +244,81 @@ text::text(const string & font, const string &textdata) {
    
    glut_bitmap_font = itor->second;
    this->textdata = textdata;
+   layout = glyph_cache::layout (glut_bitmap_font, textdata);
+   TRACE ('c', "text", textdata.size());
 }
+const string& text::get_fontname() const {
+   return fontname[glut_bitmap_font];
+}
+
 void text::draw (const vertex& center, const rgbcolor& color) const {
    DEBUGF ('d', this << "(" << center << "," << color << ")");
-   rgbcolor newColor(color);
-   glColor3ubv (newColor.ubvec);
-   glRasterPos2i (center.xpos, center.ypos);
-   glutBitmapString (glut_bitmap_font, (GLubyte*) textdata.c_str());
+   TRACE ('d', "text", textdata.size());
+   render::backend().draw_glyphs (layout, center, color);
 }
+
 void ellipse::draw (const vertex& center, const rgbcolor& color) const {
    DEBUGF ('d', this << "(" << center << "," << color << ")");
-   rgbcolor newColor(color);
-   glBegin (GL_POLYGON);
-   glEnable (GL_LINE_SMOOTH);
-   glColor3ubv (newColor.ubvec3());
-   float x,y;
-   float t;
-   for(t = 0.0; t <= 360; t +=0.02){
-      x = center.xpos + dimension.xpos*sin(t);
-      y = center.ypos + dimension.ypos*cos(t);
-      glVertex2f(x,y);
-   }
-    glEnd();
+   TRACE ('d', "ellipse", outline.size());
+   render::backend().fill_polygon (outline.data(), outline.size(),
+                                   center, color);
 }
 
 void polygon::draw (const vertex& center, const rgbcolor& color) const {
    DEBUGF ('d', this << "(" << center << "," << color << ")");
-   
-   glBegin (GL_POLYGON);
-   rgbcolor newColor(color);
-   glColor3ubv (newColor.ubvec3());
+   TRACE ('d', "polygon", vertices.size());
+   vertex_list triangles;
+   tessellate (triangles);
+   render::backend().fill_triangles (triangles.data(), triangles.size(),
+                                     center, color);
+}
+
+bool shape::tessellate (vertex_list&) const {
+   return false;
+}
 
-   for(auto vert : vertices) {
-      glVertex2f (vert.xpos+center.xpos,
-            vert.ypos+center.ypos);
+// A fan from the center.
+static void fan (const vertex_list& outline, vertex_list& triangles) {
+   vertex origin (0.0f, 0.0f);
+   for (size_t i = 0; i < outline.size(); ++i) {
+      triangles.push_back (origin);
+      triangles.push_back (outline[i]);
+      triangles.push_back (outline[(i + 1) % outline.size()]);
    }
-   glEnd();
+}
+
+bool ellipse::tessellate (vertex_list& triangles) const {
+   fan (outline, triangles);
+   return true;
+}
+
+void ellipse::tessellate_at (GLfloat scale, vertex_list& outline_,
+                             vertex_list& triangles) const {
+   size_t segments = segments_at (scale);
+   sample (segments, outline_);
+   triangles.reserve (triangles.size() + 3 * segments);
+   fan (outline_, triangles);
+}
+
+bool polygon::tessellate (vertex_list& triangles) const {
+   for (uint32_t index: indices) triangles.push_back (vertices[index]);
+   return true;
+}
+
+bbox text::bounds() const {
+   return bbox (layout.left, layout.bottom, layout.right, layout.top);
+}
+
+bbox ellipse::bounds() const {
+   GLfloat xradius = fabs (dimension.xpos);
+   GLfloat yradius = fabs (dimension.ypos);
+   return {-xradius, -yradius, xradius, yradius};
+}
+
+bbox polygon::bounds() const {
+   bbox box;
+   for (const auto& vert: vertices) box.expand (vert);
+   return box;
 }
 
 void shape::show (ostream& out) const {
@@ -179,44 +346,89 @@ ostream& operator<< (ostream& out, const shape& obj) {
    return out;
 }
 
+//
+// Each rail pair is the outer and inner edge of the band at one join,
+// and consecutive pairs make a quad.  A mitred join has one pair on
+// the bisector.  A bevelled join has one pair on each edge's normal,
+// and the quad between them fills the corner.  The band is the same
+// whichever way the outline turns, so no orientation is needed.
+//
+void stroke_outline (const vertex* outline, size_t count, GLfloat width,
+                     vertex_list& triangles) {
+   static const double miter_limit = 4;
+   auto same = [] (const vertex& a, const vertex& b) {
+      return a.xpos == b.xpos and a.ypos == b.ypos;
+   };
+   vertex_list points;
+   points.reserve (count);
+   for (size_t i = 0; i < count; ++i) {
+      if (points.empty() or not same (points.back(), outline[i])) {
+         points.push_back (outline[i]);
+      }
+   }
+   while (points.size() > 1 and same (points.front(), points.back())) {
+      points.pop_back();
+   }
+   size_t size = points.size();
+   if (size < 2 or not (width > 0)) return;
+   double half = width / 2.0;
+   auto normal = [] (const vertex& from, const vertex& to) {
+      double dx = double (to.xpos) - from.xpos;
+      double dy = double (to.ypos) - from.ypos;
+      double length = hypot (dx, dy);
+      return make_pair (-dy / length, dx / length);
+   };
+   vector<pair<vertex,vertex>> rails;
+   rails.reserve (size * 2);
+   auto rail = [&rails] (const vertex& at, double xoff, double yoff) {
+      rails.emplace_back (vertex (at.xpos + xoff, at.ypos + yoff),
+                          vertex (at.xpos - xoff, at.ypos - yoff));
+   };
+   for (size_t i = 0; i < size; ++i) {
+      const vertex& here = points[i];
+      auto before = normal (points[(i + size - 1) % size], here);
+      auto after = normal (here, points[(i + 1) % size]);
+      double xmiter = before.first + after.first;
+      double ymiter = before.second + after.second;
+      double length = hypot (xmiter, ymiter);
+      double cosine = length / 2;
+      if (cosine * miter_limit < 1) {
+         rail (here, before.first * half, before.second * half);
+         rail (here, after.first * half, after.second * half);
+      }else {
+         double scale = half / cosine / length;
+         rail (here, xmiter * scale, ymiter * scale);
+      }
+   }
+   for (size_t i = 0; i < rails.size(); ++i) {
+      const auto& from = rails[i];
+      const auto& to = rails[(i + 1) % rails.size()];
+      triangles.insert (triangles.end(), {from.first, from.second,
+                        to.first, to.first, from.second, to.second});
+   }
+}
+
+static void stroke_border (const vertex_list& outline, const vertex& center,
+                           float width, const rgbcolor& color) {
+   vertex_list triangles;
+   stroke_outline (outline.data(), outline.size(), width, triangles);
+   render::backend().fill_triangles (triangles.data(), triangles.size(),
+                                     center, color);
+}
+
 void text::border(vertex center, float width, rgbcolor color) const {
    DEBUGF ('d', this << "(" << width << "," << color << ")");
-  
-
+   bbox box = bounds();
+   stroke_border ({{box.left, box.bottom}, {box.left, box.top},
+                   {box.right, box.top}, {box.right, box.bottom}},
+                  center, width, color);
 }
 
 void ellipse::border(vertex center, float width, rgbcolor color) const {
    DEBUGF ('d', this << "(" << width << "," << color << ")");
-   rgbcolor newColor(color);
-   glLineWidth(width); 
-   glEnable (GL_LINE_SMOOTH);
-   glColor3ubv (newColor.ubvec3());
-   glBegin (GL_LINES);
-   float x,y;
-   float t;
-   for(t = 0.0; t <= 360; t +=0.02)
-   {
-      x = center.xpos + dimension.xpos*sin(t);
-      y = center.ypos + dimension.ypos*cos(t);
-      glVertex2f(x,y);
-    }
-    glEnd();
+   stroke_border (outline, center, width, color);
 }
 
 void polygon::border(vertex center, float width, rgbcolor color) const {
-   glLineWidth(width); 
-   rgbcolor newColor(color);
-   glColor3ubv(newColor.ubvec3());
-   glBegin(GL_LINES);
-   for(int i = 0; i < vertices.size()-1; ++i) {
-      glVertex2f (vertices[i].xpos+center.xpos,
-            vertices[i].ypos+center.ypos);
-      glVertex2f (vertices[i+1].xpos+center.xpos,
-            vertices[i+1].ypos+center.ypos);
-   }
-   glVertex2f(vertices.back().xpos+center.xpos, 
-      vertices.back().ypos+center.ypos);
-   glVertex2f(vertices[0].xpos+center.xpos, 
-      vertices[0].ypos+center.ypos);
-   glEnd();
+   stroke_border (vertices, center, width, color);
 }
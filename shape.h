@@ -3,14 +3,18 @@
 #ifndef __SHAPE_H__
 #define __SHAPE_H__
 
+#include <cstdint>
 #include <iomanip>
+#include <initializer_list>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
 #include <utility>
 #include <vector>
 #include <cmath>
 using namespace std;
 
+#include "glyph.h"
 #include "rgbcolor.h"
 
 //
@@ -43,11 +47,46 @@ struct vertex {
       xpos = (GLfloat)x; ypos = (GLfloat)y;
    }
 };
-using vertex_list = vector<vertex>;
+// Polymorphic allocators, so a shape's arrays can come from
+// shape_arena while every other list uses the heap.
+using vertex_list = pmr::vector<vertex>;
+using index_list = pmr::vector<uint32_t>;
 using shape_ptr = shared_ptr<shape>; 
 
+//
+// bbox -
+//    Axis-aligned bounding box.  A default box is empty, and grows
+//    with expand.
+//
+
+struct bbox {
+   GLfloat left {HUGE_VALF};
+   GLfloat bottom {HUGE_VALF};
+   GLfloat right {-HUGE_VALF};
+   GLfloat top {-HUGE_VALF};
+   bbox() {}
+   bbox (GLfloat left, GLfloat bottom, GLfloat right, GLfloat top):
+         left(left), bottom(bottom), right(right), top(top) {}
+   bool empty() const { return left > right or bottom > top; }
+   void expand (const vertex& where);
+   void expand (const bbox& box);
+   bbox offset (const vertex& delta) const {
+      return {left + delta.xpos, bottom + delta.ypos,
+              right + delta.xpos, top + delta.ypos};
+   }
+   bool intersects (const bbox& box) const {
+      return left <= box.right and box.left <= right
+         and bottom <= box.top and box.bottom <= top;
+   }
+};
+
 //
 // Abstract base class for all shapes in this system.
+// tessellate appends the shape's fill, in local coordinates, as a
+// list of independent triangles, and returns false for shapes that
+// cannot be drawn that way.  bounds is the box around everything
+// draw may touch, in local coordinates.  border strokes the outline,
+// or for text the box around it, as triangles.
 //
 
 class shape {
@@ -64,11 +103,16 @@ class shape {
       virtual void show (ostream&) const;
       virtual void border(vertex center, float width, rgbcolor color)
        const = 0;
+      virtual bool tessellate (vertex_list& triangles) const;
+      virtual bbox bounds() const = 0;
 };
 
 
 //
 // Class for printing text.
+// The string is laid out once, at construction, from the font's
+// glyph atlas.  draw hands the layout to the backend, and bounds is
+// the box around its ink.
 //
 
 class text: public shape {
@@ -82,6 +126,7 @@ class text: public shape {
       // GLUT_BITMAP_TIMES_ROMAN_10
       // GLUT_BITMAP_TIMES_ROMAN_24
       string textdata;
+      text_layout layout;
    public:
       text (void* glut_bitmap_font, const string& textdata);
       text (const string & font, const string &textdata);
@@ -89,21 +134,44 @@ class text: public shape {
       virtual void show (ostream&) const override;
      virtual void border(vertex center, float width, rgbcolor color)
        const override;
+      virtual bbox bounds() const override;
+      void* get_font() const { return glut_bitmap_font; }
+      const string& get_fontname() const;
+      const string& get_textdata() const { return textdata; }
+      const text_layout& get_layout() const { return layout; }
 };
 
 //
 // Classes for ellipse and circle.
+// The outline is tessellated once, at construction, by sampling a
+// shared unit circle table.  The number of segments is chosen from
+// the radius so the chord error stays under a quarter pixel.  Like
+// the polygon's arrays, it is allocated from shape_arena.
+// segments_at, tessellate_at -
+//    The segment count, and an outline and its triangles put in
+//    empty lists in the shape's own coordinates, for drawing it at
+//    scale times its size, so a scaled object is as smooth as an
+//    ellipse that size would be.
 //
 
 class ellipse: public shape {
    protected:
       vertex dimension;
+      vertex_list outline;
+      void sample (size_t segments, vertex_list& into) const;
    public:
       ellipse (GLfloat width, GLfloat height);
       virtual void draw (const vertex&, const rgbcolor&) const override;
       virtual void show (ostream&) const override;
       virtual void border(vertex center, float width, rgbcolor color)
        const override;
+      virtual bool tessellate (vertex_list& triangles) const override;
+      virtual bbox bounds() const override;
+      size_t segments_at (GLfloat scale) const;
+      void tessellate_at (GLfloat scale, vertex_list& outline,
+                          vertex_list& triangles) const;
+      const vertex_list& get_outline() const { return outline; }
+      const vertex& get_dimension() const { return dimension; }
 };
 
 class circle: public ellipse {
@@ -114,17 +182,29 @@ public:
 
 //
 // Class polygon.
+// The outline may be concave.  It is triangulated once, at
+// construction, into indices, three per triangle, which tessellate
+// and draw use, so every polygon is filled as a list of independent
+// triangles.  The subclasses inherit it.  Both arrays are allocated
+// from shape_arena, and a vertex list already there is moved in.
 //
 
 class polygon: public shape {
    protected:
       const vertex_list vertices;
+      const index_list indices;
    public:
       polygon (const vertex_list& vertices);
+      polygon (vertex_list&& vertices);
+      polygon (initializer_list<vertex> vertices);
       virtual void draw (const vertex&, const rgbcolor&) const override;
       virtual void show (ostream&) const override;
       virtual void border(vertex center, float width, rgbcolor color)
        const override;
+      virtual bool tessellate (vertex_list& triangles) const override;
+      virtual bbox bounds() const override;
+      const vertex_list& get_vertices() const { return vertices; }
+      const index_list& get_indices() const { return indices; }
 };
 
 
@@ -164,5 +244,15 @@ class diamond: public polygon {
 
 ostream& operator<< (ostream& out, const shape&);
 
+//
+// stroke_outline -
+//    Append the band width wide centered on a closed outline, as
+//    independent triangles.  Joins are mitred, or bevelled where the
+//    miter would reach more than four half-widths from the corner.
+//    Repeated points are skipped.
+//
+void stroke_outline (const vertex* outline, size_t count, GLfloat width,
+                     vertex_list& triangles);
+
 #endif
 
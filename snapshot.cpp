@@ -0,0 +1,303 @@
+// $Id$
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+#include "arena.h"
+#include "debug.h"
+#include "graphics.h"
+#include "interp.h"
+#include "script.h"
+#include "snapshot.h"
+#include "trace.h"
+#include "util.h"
+
+static const char snapshot_magic[8] {'g','d','r','a','w','s','n','p'};
+static const uint32_t snapshot_byte_order = 0x01020304;
+
+//
+// The exact class of each shape is kept, so a reloaded scene shows
+// the same objmap.  Derived polygons are rebuilt from their sizes,
+// which are recovered from the vertices the constructors made.
+//
+static snapshot::shape_record describe (const shape& pshape,
+                                        vector<vertex>& vertices,
+                                        string& chars) {
+   snapshot::shape_record record {};
+   const type_info& type = typeid (pshape);
+   if (auto shape_text = dynamic_cast<const text*> (&pshape)) {
+      const string& font = shape_text->get_fontname();
+      const string& textdata = shape_text->get_textdata();
+      record.type = snapshot::kind::text;
+      record.first = chars.size();
+      record.count = font.size();
+      chars += font;
+      record.text_first = chars.size();
+      record.text_count = textdata.size();
+      chars += textdata;
+   }else if (auto shape_ellipse = dynamic_cast<const ellipse*>
+                                         (&pshape)) {
+      record.type = type == typeid (circle) ? snapshot::kind::circle
+                                            : snapshot::kind::ellipse;
+      record.width = shape_ellipse->get_dimension().xpos;
+      record.height = shape_ellipse->get_dimension().ypos;
+   }else {
+      const vertex_list& points = dynamic_cast<const polygon&>
+                                        (pshape).get_vertices();
+      record.type = snapshot::kind::polygon;
+      using kind = snapshot::kind;
+      if (type == typeid (rectangle)) record.type = kind::rectangle;
+      if (type == typeid (square)) record.type = kind::square;
+      if (type == typeid (triangle)) record.type = kind::triangle;
+      if (type == typeid (equilateral)) record.type = kind::equilateral;
+      if (type == typeid (diamond)) record.type = kind::diamond;
+      switch (record.type) {
+         case snapshot::kind::rectangle:
+         case snapshot::kind::square:
+         case snapshot::kind::equilateral:
+            record.width = points[2].xpos * 2;
+            record.height = points[2].ypos * 2;
+            break;
+         case snapshot::kind::diamond:
+            record.width = points[3].xpos * 2;
+            record.height = points[0].ypos * 2;
+            break;
+         default:
+            break;
+      }
+      record.first = vertices.size();
+      record.count = points.size();
+      vertices.insert (vertices.end(), points.begin(), points.end());
+   }
+   return record;
+}
+
+template <typename record_t>
+static void put (string& image, const record_t* records, size_t count) {
+   image.append (reinterpret_cast<const char*> (records),
+                 count * sizeof (record_t));
+   image.resize ((image.size() + 3) & ~size_t (3));
+}
+
+template <typename record_t>
+static void put (string& image, const vector<record_t>& records) {
+   put (image, records.data(), records.size());
+}
+
+void snapshot::save (const string& filename) {
+   TRACE_SCOPE ('m', "snapshot save", window::num_objects());
+   vector<shape_record> shapes;
+   vector<name_record> names;
+   vector<vertex> vertices;
+   string chars;
+   unordered_map<const shape*,uint32_t> shape_ids;
+   auto shape_id = [&] (const shape_ptr& pshape) {
+      auto found = shape_ids.emplace (pshape.get(), shapes.size());
+      if (found.second) {
+         shapes.push_back (describe (*pshape, vertices, chars));
+      }
+      return found.first->second;
+   };
+   for (const auto& entry: interpreter::get_objmap()) {
+      uint32_t id = shape_id (entry.second);
+      name_record name {uint32_t (chars.size()),
+                        uint32_t (entry.first.size()), id};
+      chars += entry.first;
+      names.push_back (name);
+   }
+   const scene_store& scene = window::scene();
+   size_t count = scene.size();
+   vector<uint32_t> object_shapes (count);
+   vector<GLfloat> move_by (count);
+   vector<GLfloat> border_widths (count);
+   vector<rgbcolor> border_colors (count, rgbcolor());
+   for (size_t slot = 0; slot < count; ++slot) {
+      object_shapes[slot] = shape_id (scene.geometry_of (slot).pshape);
+      move_by[slot] = scene.move_by (slot);
+      border_widths[slot] = scene.border_width (slot);
+      border_colors[slot] = scene.border_color (slot);
+   }
+   header head {};
+   memcpy (head.magic, snapshot_magic, sizeof head.magic);
+   head.version = version;
+   head.byte_order = snapshot_byte_order;
+   head.num_shapes = shapes.size();
+   head.num_names = names.size();
+   head.num_objects = count;
+   head.num_vertices = vertices.size();
+   head.num_chars = chars.size();
+   string image (reinterpret_cast<const char*> (&head), sizeof head);
+   put (image, shapes);
+   put (image, names);
+   put (image, vertices);
+   put (image, chars.data(), chars.size());
+   put (image, object_shapes);
+   put (image, scene.xpos(), count);
+   put (image, scene.ypos(), count);
+   put (image, move_by);
+   put (image, border_widths);
+   put (image, scene.colors(), count);
+   put (image, border_colors);
+   put (image, scene.angles(), count);
+   put (image, scene.xscales(), count);
+   put (image, scene.yscales(), count);
+   ofstream outfile (filename, ios::binary);
+   if (outfile.fail()) {
+      syscall_error (filename);
+      return;
+   }
+   outfile.write (image.data(), image.size());
+   outfile.close();
+   if (outfile.fail()) syscall_error (filename);
+   DEBUGF ('m', filename << ": " << shapes.size() << " shapes, "
+           << count << " objects, " << image.size()
+           << " bytes");
+}
+
+//
+// Records are used where they lie in the mapping.  Every index in
+// them is checked, and every shape built, before the first name or
+// object is added, so a bad file loads nothing.
+//
+template <typename record_t>
+static const record_t* take (const char*& pos, const char* end,
+                             size_t count) {
+   if (size_t (end - pos) / sizeof (record_t) < count) {
+      throw runtime_error ("truncated snapshot");
+   }
+   const record_t* records = reinterpret_cast<const record_t*> (pos);
+   pos += min<size_t> ((count * sizeof (record_t) + 3) & ~size_t (3),
+                       end - pos);
+   return records;
+}
+
+static shape_ptr rebuild (const snapshot::shape_record& record,
+                          const vertex* vertices, uint32_t num_vertices,
+                          const char* chars, uint32_t num_chars) {
+   auto chars_at = [&] (uint32_t first, uint32_t count) {
+      if (first > num_chars or count > num_chars - first) {
+         throw runtime_error ("bad string in snapshot");
+      }
+      return string (chars + first, count);
+   };
+   using kind = snapshot::kind;
+   switch (record.type) {
+      case kind::text:
+         return shape_arena::make<text> (
+                chars_at (record.first, record.count),
+                chars_at (record.text_first, record.text_count));
+      case kind::ellipse:
+         return shape_arena::make<ellipse> (record.width, record.height);
+      case kind::circle:
+         return shape_arena::make<circle> (record.width);
+      case kind::rectangle:
+         return shape_arena::make<rectangle> (record.width,
+                                              record.height);
+      case kind::square:
+         return shape_arena::make<square> (record.width);
+      case kind::equilateral:
+         return shape_arena::make<equilateral> (record.width);
+      case kind::diamond:
+         return shape_arena::make<diamond> (record.width, record.height);
+      case kind::polygon:
+      case kind::triangle:
+         break;
+      default:
+         throw runtime_error ("bad shape kind in snapshot");
+   }
+   if (record.first > num_vertices
+       or record.count > num_vertices - record.first) {
+      throw runtime_error ("bad vertex list in snapshot");
+   }
+   const vertex* points = vertices + record.first;
+   if (record.type == kind::polygon) {
+      return shape_arena::make<polygon> (
+             vertex_list (points, points + record.count,
+                          shape_arena::resource()));
+   }
+   if (record.count != 3) {
+      throw runtime_error ("bad triangle in snapshot");
+   }
+   return shape_arena::make<triangle> (points[0], points[1],
+                                       points[2]);
+}
+
+void snapshot::load (const string& filename) {
+   TRACE_SCOPE ('m', "snapshot load", 0);
+   script_source source (filename);
+   if (source.fail()) {
+      syscall_error (filename);
+      return;
+   }
+   try {
+      const char* pos = source.text().data();
+      const char* end = pos + source.text().size();
+      const header& head = *take<header> (pos, end, 1);
+      if (memcmp (head.magic, snapshot_magic, sizeof head.magic) != 0) {
+         throw runtime_error ("not a snapshot");
+      }
+      if (head.byte_order != snapshot_byte_order) {
+         throw runtime_error ("snapshot has the wrong byte order");
+      }
+      if (head.version != version) {
+         throw runtime_error ("snapshot version "
+                              + to_string (head.version) + ", expected "
+                              + to_string (version));
+      }
+      auto shape_records = take<shape_record> (pos, end,
+                                               head.num_shapes);
+      auto name_records = take<name_record> (pos, end, head.num_names);
+      auto vertices = take<vertex> (pos, end, head.num_vertices);
+      auto chars = take<char> (pos, end, head.num_chars);
+      uint32_t count = head.num_objects;
+      scene_columns columns;
+      columns.count = count;
+      columns.shapes = take<uint32_t> (pos, end, count);
+      columns.xpos = take<GLfloat> (pos, end, count);
+      columns.ypos = take<GLfloat> (pos, end, count);
+      columns.move_by = take<GLfloat> (pos, end, count);
+      columns.border_widths = take<GLfloat> (pos, end, count);
+      columns.colors = take<rgbcolor> (pos, end, count);
+      columns.border_colors = take<rgbcolor> (pos, end, count);
+      columns.angles = take<GLfloat> (pos, end, count);
+      columns.xscales = take<GLfloat> (pos, end, count);
+      columns.yscales = take<GLfloat> (pos, end, count);
+      vector<shape_ptr> shapes (head.num_shapes);
+      for (uint32_t id = 0; id < head.num_shapes; ++id) {
+         shapes[id] = rebuild (shape_records[id], vertices,
+                               head.num_vertices, chars, head.num_chars);
+      }
+      auto shape_at = [&] (uint32_t id) -> const shape_ptr& {
+         if (id >= shapes.size()) {
+            throw runtime_error ("bad shape in snapshot");
+         }
+         return shapes[id];
+      };
+      vector<pair<string,shape_ptr>> names;
+      for (uint32_t index = 0; index < head.num_names; ++index) {
+         const name_record& name = name_records[index];
+         if (name.first > head.num_chars
+             or name.count > head.num_chars - name.first) {
+            throw runtime_error ("bad name in snapshot");
+         }
+         names.emplace_back (string (chars + name.first, name.count),
+                             shape_at (name.shape));
+      }
+      for (uint32_t index = 0; index < count; ++index) {
+         shape_at (columns.shapes[index]);
+      }
+      for (const auto& name: names) {
+         interpreter::define (name.first, name.second);
+      }
+      window::append (shapes, columns);
+      DEBUGF ('m', filename << ": " << head.num_shapes << " shapes, "
+              << head.num_objects << " objects");
+   }catch (runtime_error& error) {
+      complain() << filename << ": " << error.what() << endl;
+   }
+}
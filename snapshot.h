@@ -0,0 +1,73 @@
+// $Id$
+
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <cstdint>
+#include <string>
+using namespace std;
+
+#include <GL/freeglut.h>
+
+//
+// snapshot -
+//    Binary image of a loaded scene: the named shapes in the
+//    interpreter's objmap and the objects in the window, so a scene
+//    can be started again without running its script.
+// save -
+//    Write the current objmap and window objects to a file.
+// load -
+//    Map a snapshot file and rebuild its shapes and objects directly
+//    from fixed-size records, with no text to scan.  Errors are
+//    reported and nothing is loaded.
+//
+// The file is a header followed by arrays of records, in the order
+// shapes, names, vertices and a pool of string bytes, and then the
+// objects column by column as scene_store keeps them: shape index,
+// x, y, move_by, border width, color, border color, angle, x scale
+// and y scale.  Every array
+// is padded to a multiple of four bytes, so each may be used in place
+// from a mapping, and the columns are appended to the window whole.
+// Numbers are in the byte order of the writer, which the header
+// records; a mismatch, like a different version, is rejected rather
+// than converted.
+//
+
+class snapshot {
+   public:
+      static constexpr uint32_t version = 2;
+      enum class kind: uint32_t {
+         text, ellipse, circle, polygon, rectangle, square, triangle,
+         equilateral, diamond,
+      };
+      struct header {
+         char magic[8];
+         uint32_t version;
+         uint32_t byte_order;
+         uint32_t num_shapes;
+         uint32_t num_names;
+         uint32_t num_objects;
+         uint32_t num_vertices;
+         uint32_t num_chars;
+         uint32_t reserved;
+      };
+      struct shape_record {
+         kind type;
+         uint32_t first;         // vertices, or font name in chars
+         uint32_t count;
+         uint32_t text_first;    // text contents in chars
+         uint32_t text_count;
+         GLfloat width;
+         GLfloat height;
+      };
+      struct name_record {
+         uint32_t first;         // in chars
+         uint32_t count;
+         uint32_t shape;
+      };
+      static void save (const string& filename);
+      static void load (const string& filename);
+};
+
+#endif
+
@@ -0,0 +1,156 @@
+// $Id$
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+#include "debug.h"
+#include "spatial.h"
+#include "trace.h"
+#include "util.h"
+
+spatial_grid::cell_range spatial_grid::cells_of (const bbox& box) const {
+   if (box.empty()) return {1, 1, 0, 0};
+   const GLfloat limit = 1 << 30;
+   auto cell = [this, limit] (GLfloat coord) {
+      return int (floor (max (-limit, min (limit, coord / cell_size))));
+   };
+   return {cell (box.left), cell (box.bottom),
+           cell (box.right), cell (box.top)};
+}
+
+static bool oversized (int left, int bottom, int right, int top,
+                       int max_cells) {
+   return (int64_t (right) - left + 1) * (int64_t (top) - bottom + 1)
+          > max_cells;
+}
+
+void spatial_grid::link (size_t slot, const cell_range& range) {
+   if (range.left > range.right) return;
+   if (oversized (range.left, range.bottom, range.right, range.top,
+                  max_cells)) {
+      oversize.push_back (slot);
+      return;
+   }
+   for (int x = range.left; x <= range.right; ++x) {
+      for (int y = range.bottom; y <= range.top; ++y) {
+         cells[key (x, y)].push_back (slot);
+      }
+   }
+}
+
+void spatial_grid::unlink (size_t slot, const cell_range& range) {
+   if (range.left > range.right) return;
+   if (oversized (range.left, range.bottom, range.right, range.top,
+                  max_cells)) {
+      oversize.erase (find (oversize.begin(), oversize.end(), slot));
+      return;
+   }
+   for (int x = range.left; x <= range.right; ++x) {
+      for (int y = range.bottom; y <= range.top; ++y) {
+         auto itor = cells.find (key (x, y));
+         vector<size_t>& slots = itor->second;
+         slots.erase (find (slots.begin(), slots.end(), slot));
+         if (slots.empty()) cells.erase (itor);
+      }
+   }
+}
+
+void spatial_grid::clear() {
+   cells.clear();
+   boxes.clear();
+   oversize.clear();
+   stamps.clear();
+   stamp = 0;
+}
+
+void spatial_grid::insert (size_t slot, const bbox& box) {
+   if (slot >= boxes.size()) {
+      boxes.resize (slot + 1);
+      stamps.resize (slot + 1, 0);
+   }
+   boxes[slot] = box;
+   link (slot, cells_of (box));
+}
+
+void spatial_grid::insert (size_t first, const vector<bbox>& added) {
+   size_t last = first + added.size();
+   if (last > boxes.size()) {
+      boxes.resize (last);
+      stamps.resize (last, 0);
+   }
+   vector<pair<uint64_t,size_t>> links;
+   links.reserve (added.size());
+   for (size_t slot = first; slot < last; ++slot) {
+      const bbox& box = boxes[slot] = added[slot - first];
+      cell_range range = cells_of (box);
+      if (range.left > range.right) continue;
+      if (oversized (range.left, range.bottom, range.right, range.top,
+                     max_cells)) {
+         oversize.push_back (slot);
+         continue;
+      }
+      for (int x = range.left; x <= range.right; ++x) {
+         for (int y = range.bottom; y <= range.top; ++y) {
+            links.emplace_back (key (x, y), slot);
+         }
+      }
+   }
+   sort (links.begin(), links.end());
+   for (auto run = links.begin(); run != links.end();) {
+      auto next = run;
+      while (next != links.end() and next->first == run->first) ++next;
+      vector<size_t>& slots = cells[run->first];
+      slots.reserve (slots.size() + (next - run));
+      for (; run != next; ++run) slots.push_back (run->second);
+   }
+   DEBUGF ('s', added.size() << " inserted, " << links.size()
+           << " links, " << cells.size() << " cells");
+}
+
+void spatial_grid::update (size_t slot, const bbox& box) {
+   cell_range from = cells_of (boxes[slot]);
+   cell_range to = cells_of (box);
+   boxes[slot] = box;
+   if (from.left == to.left and from.bottom == to.bottom
+       and from.right == to.right and from.top == to.top) return;
+   unlink (slot, from);
+   link (slot, to);
+}
+
+void spatial_grid::query (const bbox& box, vector<size_t>& result) {
+   if (++stamp == 0) {
+      fill (stamps.begin(), stamps.end(), 0);
+      stamp = 1;
+   }
+   size_t first = result.size();
+   auto visit = [&] (const vector<size_t>& slots) {
+      for (size_t slot: slots) {
+         if (stamps[slot] == stamp) continue;
+         stamps[slot] = stamp;
+         if (boxes[slot].intersects (box)) result.push_back (slot);
+      }
+   };
+   cell_range range = cells_of (box);
+   if (range.left <= range.right) {
+      int64_t span = (int64_t (range.right) - range.left + 1)
+                   * (int64_t (range.top) - range.bottom + 1);
+      if (span > int64_t (cells.size())) {
+         for (const auto& cell: cells) visit (cell.second);
+      }else {
+         for (int x = range.left; x <= range.right; ++x) {
+            for (int y = range.bottom; y <= range.top; ++y) {
+               auto itor = cells.find (key (x, y));
+               if (itor != cells.end()) visit (itor->second);
+            }
+         }
+      }
+      visit (oversize);
+   }
+   sort (result.begin() + first, result.end());
+   TRACE ('s', "query", result.size() - first);
+   DEBUGF ('s', result.size() - first << " of " << boxes.size()
+           << " visible");
+}
+
@@ -0,0 +1,57 @@
+// $Id$
+
+#ifndef __SPATIAL_H__
+#define __SPATIAL_H__
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+#include "shape.h"
+
+//
+// spatial_grid -
+//    Uniform grid over world-space boxes, indexed by object slot.
+//    Only occupied cells are stored, so a sparse world of any size
+//    costs memory in proportion to the objects in it.  A box that
+//    would cover more than max_cells cells goes on an oversize list
+//    that every query checks instead.
+// insert, update -
+//    Add a slot, or move it to a new box.  An update that stays in
+//    the same cells only rewrites the stored box.  Inserting a run of
+//    slots at once sorts their cell links and fills each cell in one
+//    lookup.
+// query -
+//    Append to result, in increasing slot order (painter's order),
+//    every slot whose box intersects the given box.
+//
+
+class spatial_grid {
+   private:
+      static const int max_cells = 64;
+      GLfloat cell_size;
+      unordered_map<uint64_t,vector<size_t>> cells;
+      vector<bbox> boxes;
+      vector<size_t> oversize;
+      vector<unsigned> stamps;
+      unsigned stamp {0};
+      struct cell_range { int left, bottom, right, top; };
+      cell_range cells_of (const bbox& box) const;
+      static uint64_t key (int x, int y) {
+         return uint64_t (uint32_t (x)) << 32 | uint32_t (y);
+      }
+      void link (size_t slot, const cell_range& range);
+      void unlink (size_t slot, const cell_range& range);
+   public:
+      spatial_grid (GLfloat cell_size = 128): cell_size(cell_size) {}
+      void clear();
+      void insert (size_t slot, const bbox& box);
+      void insert (size_t first, const vector<bbox>& added);
+      void update (size_t slot, const bbox& box);
+      void query (const bbox& box, vector<size_t>& result);
+      size_t size() const { return boxes.size(); }
+};
+
+#endif
+
@@ -0,0 +1,127 @@
+// $Id$
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+#include "trace.h"
+#include "util.h"
+
+bool tracer::flags[256];
+
+using trace_clock = chrono::steady_clock;
+static const trace_clock::time_point start = trace_clock::now();
+
+struct site_info {
+   char flag;
+   const char* name;
+   const char* file;
+   int line;
+};
+
+//
+// head counts every event the owning thread has recorded; the
+// slot for an event is its count modulo capacity.  Only the
+// owner stores to head; write reads it after the store releases.
+//
+struct ring {
+   uint32_t thread;
+   atomic<uint64_t> head {0};
+   tracer::event events[tracer::capacity];
+};
+
+static mutex registry_lock;
+static vector<site_info> sites;
+static vector<unique_ptr<ring>> rings;
+static string trace_filename;
+static thread_local ring* local_ring = nullptr;
+
+static ring* attach() {
+   lock_guard<mutex> guard (registry_lock);
+   rings.push_back (make_unique<ring>());
+   rings.back()->thread = rings.size();
+   return rings.back().get();
+}
+
+static void write_at_exit() {
+   tracer::write (trace_filename);
+}
+
+void tracer::setflags (const string& initflags) {
+   for (const unsigned char flag: initflags) {
+      if (flag == '@') fill (begin (flags), end (flags), true);
+                  else flags[flag] = true;
+   }
+}
+
+void tracer::open (const string& filename) {
+   trace_filename = filename;
+   atexit (write_at_exit);
+}
+
+uint32_t tracer::site (char flag, const char* name,
+                       const char* file, int line) {
+   lock_guard<mutex> guard (registry_lock);
+   sites.push_back ({flag, name, file, line});
+   return sites.size() - 1;
+}
+
+void tracer::record (uint32_t site, char phase, int64_t arg) {
+   ring* owner = local_ring;
+   if (owner == nullptr) owner = local_ring = attach();
+   uint64_t head = owner->head.load (memory_order_relaxed);
+   event& slot = owner->events[head % capacity];
+   slot.nanos = chrono::duration_cast<chrono::nanoseconds>
+                (trace_clock::now() - start).count();
+   slot.site = site;
+   slot.phase = phase;
+   slot.arg = arg;
+   owner->head.store (head + 1, memory_order_release);
+}
+
+//
+// Called at exit, after any worker threads have been joined, so no
+// ring is still being written.
+//
+void tracer::write (const string& filename) {
+   lock_guard<mutex> guard (registry_lock);
+   ofstream out (filename, ios::binary);
+   if (not out) {
+      syscall_error (filename);
+      return;
+   }
+   file_header header {};
+   memcpy (header.magic, "gdrawtrc", sizeof header.magic);
+   header.version = version;
+   header.num_sites = sites.size();
+   header.num_rings = rings.size();
+   out.write (reinterpret_cast<const char*> (&header), sizeof header);
+   for (const site_info& info: sites) {
+      site_record record {};
+      record.flag = info.flag;
+      record.line = info.line;
+      record.name_size = strlen (info.name);
+      record.file_size = strlen (info.file);
+      out.write (reinterpret_cast<const char*> (&record), sizeof record);
+      out.write (info.name, record.name_size);
+      out.write (info.file, record.file_size);
+   }
+   for (const auto& each: rings) {
+      uint64_t head = each->head.load (memory_order_acquire);
+      ring_record record {};
+      record.thread = each->thread;
+      record.count = head < capacity ? head : capacity;
+      out.write (reinterpret_cast<const char*> (&record), sizeof record);
+      for (uint64_t index = head - record.count; index < head; ++index) {
+         out.write (reinterpret_cast<const char*>
+                    (&each->events[index % capacity]), sizeof (event));
+      }
+   }
+   if (not out) syscall_error (filename);
+}
+
@@ -0,0 +1,115 @@
+// $Id$
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+using namespace std;
+
+//
+// tracer -
+//    Static class for binary event tracing, cheap enough to leave on.
+//    Trace points are keyed by the same flag characters as DEBUGF,
+//    but are turned on separately, with setflags.  An event is a
+//    fixed-size record: a timestamp, the id of its trace point, a
+//    phase and one number.  Nothing is formatted while running.
+// rings -
+//    Each thread records into its own ring of the last capacity
+//    events, which only that thread writes, so recording takes no
+//    lock.  Rings outlive their threads.
+// open -
+//    Write every ring to the named file at exit.  The file is turned
+//    into Chrome trace JSON offline by gdraw-trace.
+// site -
+//    Register a trace point once, from the macros below, and return
+//    its id.  Its name, flag, file and line go in the file header.
+//
+// TRACE (FLAG, NAME, ARG) -
+//    Record an instant event with a numeric argument.
+// TRACE_SCOPE (FLAG, NAME, ARG) -
+//    Record a begin event here and the matching end event when the
+//    enclosing block exits.
+//
+// The file is a file_header, then for each site a site_record
+// followed by its name and file bytes, then for each thread a
+// ring_record followed by its events, oldest first.
+//
+
+class tracer {
+   public:
+      static const size_t capacity = 1 << 16;
+      static constexpr uint32_t version = 1;
+      struct event {
+         uint64_t nanos;      // since the tracer started
+         uint32_t site;
+         char phase;          // 'B' begin, 'E' end, 'i' instant
+         char unused[3];
+         int64_t arg;
+      };
+      struct file_header {
+         char magic[8];
+         uint32_t version;
+         uint32_t num_sites;
+         uint32_t num_rings;
+         uint32_t reserved;
+      };
+      struct site_record {
+         char flag;
+         char unused[3];
+         uint32_t line;
+         uint32_t name_size;
+         uint32_t file_size;
+      };
+      struct ring_record {
+         uint32_t thread;
+         uint32_t unused;
+         uint64_t count;
+      };
+   private:
+      static bool flags[256];
+   public:
+      static bool on (char flag) {
+         return flags[static_cast<unsigned char> (flag)];
+      }
+      static void setflags (const string& initflags);
+      static void open (const string& filename);
+      static uint32_t site (char flag, const char* name,
+                            const char* file, int line);
+      static void record (uint32_t site, char phase, int64_t arg);
+      static void write (const string& filename);
+};
+
+class trace_scope {
+   private:
+      uint32_t site;
+      bool active;
+   public:
+      trace_scope (char flag, uint32_t site, int64_t arg):
+                   site(site), active(tracer::on (flag)) {
+         if (active) tracer::record (site, 'B', arg);
+      }
+      ~trace_scope() { if (active) tracer::record (site, 'E', 0); }
+      trace_scope (const trace_scope&) = delete;
+      trace_scope& operator= (const trace_scope&) = delete;
+};
+
+#define TRACE_JOIN2(A,B) A##B
+#define TRACE_JOIN(A,B) TRACE_JOIN2(A,B)
+
+#define TRACE(FLAG,NAME,ARG) { \
+           if (tracer::on (FLAG)) { \
+              static const uint32_t trace_site = \
+                     tracer::site (FLAG, NAME, __FILE__, __LINE__); \
+              tracer::record (trace_site, 'i', ARG); \
+           } \
+        }
+#define TRACE_SCOPE(FLAG,NAME,ARG) \
+        static const uint32_t TRACE_JOIN(trace_site_,__LINE__) = \
+               tracer::site (FLAG, NAME, __FILE__, __LINE__); \
+        trace_scope TRACE_JOIN(trace_scope_,__LINE__) \
+               (FLAG, TRACE_JOIN(trace_site_,__LINE__), ARG)
+
+#endif
+
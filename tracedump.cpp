@@ -0,0 +1,120 @@
+// $Id$
+
+//
+// gdraw-trace -
+//    Reads a trace file written by gdraw -T and writes it to cout as
+//    Chrome trace event JSON, for chrome://tracing or Perfetto.  Each
+//    trace flag becomes a category and each thread's ring a tid.
+//
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "trace.h"
+#include "util.h"
+
+struct site_info {
+   char flag;
+   string name;
+   string file;
+   uint32_t line;
+};
+
+template <typename record_t>
+bool read_record (istream& in, record_t& record) {
+   return bool (in.read (reinterpret_cast<char*> (&record), sizeof record));
+}
+
+string read_string (istream& in, size_t size) {
+   string text (size, '\0');
+   in.read (&text[0], size);
+   return text;
+}
+
+//
+// Names are string literals from the source, but escape them anyway.
+//
+string json_string (const string& text) {
+   string quoted = "\"";
+   for (char byte: text) {
+      if (byte == '"' or byte == '\\') quoted += '\\';
+      if (static_cast<unsigned char> (byte) < ' ') quoted += '?';
+                                              else quoted += byte;
+   }
+   return quoted + "\"";
+}
+
+bool convert (const string& filename, ostream& out) {
+   ifstream in (filename, ios::binary);
+   if (not in) {
+      syscall_error (filename);
+      return false;
+   }
+   tracer::file_header header;
+   if (not read_record (in, header)
+    or memcmp (header.magic, "gdrawtrc", sizeof header.magic) != 0
+    or header.version != tracer::version) {
+      complain() << filename << ": not a version " << tracer::version
+                 << " trace file" << endl;
+      return false;
+   }
+   vector<site_info> sites;
+   for (uint32_t index = 0; index < header.num_sites; ++index) {
+      tracer::site_record record;
+      if (not read_record (in, record)) break;
+      string name = read_string (in, record.name_size);
+      string file = read_string (in, record.file_size);
+      sites.push_back ({record.flag, name, file, record.line});
+   }
+   if (not in) {
+      complain() << filename << ": truncated site table" << endl;
+      return false;
+   }
+   out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+   const char* separator = "";
+   for (uint32_t ring = 0; ring < header.num_rings; ++ring) {
+      tracer::ring_record record;
+      if (not read_record (in, record)) break;
+      for (uint64_t index = 0; index < record.count; ++index) {
+         tracer::event event;
+         if (not read_record (in, event)) break;
+         if (event.site >= sites.size()) continue;
+         const site_info& site = sites[event.site];
+         out << separator << "{\"name\": " << json_string (site.name)
+             << ", \"cat\": \"" << site.flag << "\", \"ph\": \""
+             << event.phase << "\", \"ts\": " << event.nanos / 1000
+             << "." << event.nanos / 100 % 10 << event.nanos / 10 % 10
+             << event.nanos % 10 << ", \"pid\": 1, \"tid\": "
+             << record.thread;
+         if (event.phase == 'i') out << ", \"s\": \"t\"";
+         if (event.phase != 'E') {
+            out << ", \"args\": {\"arg\": " << event.arg
+                << ", \"where\": " << json_string (site.file + "["
+                   + to_string (site.line) + "]") << "}";
+         }
+         out << "}";
+         separator = ",\n";
+      }
+   }
+   out << "\n]}" << endl;
+   if (not in) {
+      complain() << filename << ": truncated events" << endl;
+      return false;
+   }
+   return true;
+}
+
+int main (int argc, char** argv) {
+   sys_info::execname (argv[0]);
+   if (argc != 2) {
+      cerr << "Usage: " << sys_info::execname() << " trace-file" << endl;
+      return 1;
+   }
+   convert (argv[1], cout);
+   return sys_info::exit_status();
+}
+
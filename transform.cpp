@@ -0,0 +1,86 @@
+// $Id$
+
+#include <cmath>
+#include <immintrin.h>
+using namespace std;
+
+#include "transform.h"
+
+transform2d::transform2d (const vertex& center, GLfloat angle,
+                          GLfloat xscale, GLfloat yscale):
+             offset(center) {
+   GLfloat cosine = cos (angle);
+   GLfloat sine = sin (angle);
+   xx = cosine * xscale;
+   xy = -sine * yscale;
+   yx = sine * xscale;
+   yy = cosine * yscale;
+}
+
+bbox transform2d::apply (const bbox& local) const {
+   if (local.empty()) return local;
+   if (is_translation()) return local.offset (offset);
+   bbox box;
+   box.expand (apply (vertex (local.left, local.bottom)));
+   box.expand (apply (vertex (local.left, local.top)));
+   box.expand (apply (vertex (local.right, local.bottom)));
+   box.expand (apply (vertex (local.right, local.top)));
+   return box;
+}
+
+void transform_vertices_scalar (const transform2d& xform,
+                                const vertex* local, size_t count,
+                                vertex* world) {
+   for (size_t index = 0; index < count; ++index) {
+      world[index] = xform.apply (local[index]);
+   }
+}
+
+//
+// Vertices are interleaved x, y, so a register holds four of them.
+// Multiplying by (xx, yy, ...) and the pair-swapped register by
+// (xy, yx, ...) and adding gives both outputs of every vertex with
+// the same operations, in the same order, as apply.
+//
+__attribute__ ((target ("avx2")))
+void transform_vertices_avx2 (const transform2d& xform,
+                              const vertex* local, size_t count,
+                              vertex* world) {
+   const GLfloat* from = reinterpret_cast<const GLfloat*> (local);
+   GLfloat* into = reinterpret_cast<GLfloat*> (world);
+   const __m256 same = _mm256_setr_ps (xform.xx, xform.yy, xform.xx,
+                                       xform.yy, xform.xx, xform.yy,
+                                       xform.xx, xform.yy);
+   const __m256 swapped = _mm256_setr_ps (xform.xy, xform.yx, xform.xy,
+                                          xform.yx, xform.xy, xform.yx,
+                                          xform.xy, xform.yx);
+   const __m256 offset = _mm256_setr_ps (
+         xform.offset.xpos, xform.offset.ypos, xform.offset.xpos,
+         xform.offset.ypos, xform.offset.xpos, xform.offset.ypos,
+         xform.offset.xpos, xform.offset.ypos);
+   size_t index = 0;
+   for (; index + 4 <= count; index += 4) {
+      __m256 coords = _mm256_loadu_ps (from + 2 * index);
+      __m256 pairs = _mm256_permute_ps (coords, 0xB1);
+      __m256 linear = _mm256_add_ps (_mm256_mul_ps (coords, same),
+                                     _mm256_mul_ps (pairs, swapped));
+      _mm256_storeu_ps (into + 2 * index, _mm256_add_ps (linear, offset));
+   }
+   transform_vertices_scalar (xform, local + index, count - index,
+                              world + index);
+}
+
+bool transform_has_avx2() {
+   static const bool has_avx2 = __builtin_cpu_supports ("avx2");
+   return has_avx2;
+}
+
+void transform_vertices (const transform2d& xform, const vertex* local,
+                         size_t count, vertex* world) {
+   if (transform_has_avx2()) {
+      transform_vertices_avx2 (xform, local, count, world);
+   }else {
+      transform_vertices_scalar (xform, local, count, world);
+   }
+}
+
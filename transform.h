@@ -0,0 +1,63 @@
+// $Id$
+
+#ifndef __TRANSFORM_H__
+#define __TRANSFORM_H__
+
+#include <cstddef>
+using namespace std;
+
+#include <GL/freeglut.h>
+
+#include "shape.h"
+
+//
+// transform2d -
+//    Affine map from shape-local to window coordinates: scale along
+//    the shape's own axes, rotate counterclockwise by angle radians,
+//    then translate to the object's center.  The default is the
+//    identity.  A transform that is only a translation gives exactly
+//    the sums that adding the center gave before.
+// apply -
+//    Map one vertex, or a box to the box around its mapped corners.
+//
+// transform_vertices -
+//    Map count local vertices into world, which may not overlap
+//    local.  This is the vertex stage for whole scenes: it uses AVX2,
+//    four vertices at a time, when the CPU has it, and plain scalar
+//    code otherwise.  Both give identical results.
+// transform_vertices_scalar, transform_vertices_avx2 -
+//    The two versions, for the benchmark.  The AVX2 one must only be
+//    called if transform_has_avx2.
+//
+
+struct transform2d {
+   GLfloat xx {1};
+   GLfloat xy {0};
+   GLfloat yx {0};
+   GLfloat yy {1};
+   vertex offset {0.0f, 0.0f};
+   transform2d() {}
+   transform2d (const vertex& center, GLfloat angle, GLfloat xscale,
+                GLfloat yscale);
+   bool is_translation() const {
+      return xx == 1 and xy == 0 and yx == 0 and yy == 1;
+   }
+   vertex apply (const vertex& local) const {
+      return vertex (xx * local.xpos + xy * local.ypos + offset.xpos,
+                     yx * local.xpos + yy * local.ypos + offset.ypos);
+   }
+   bbox apply (const bbox& local) const;
+};
+
+void transform_vertices (const transform2d& xform, const vertex* local,
+                         size_t count, vertex* world);
+void transform_vertices_scalar (const transform2d& xform,
+                                const vertex* local, size_t count,
+                                vertex* world);
+void transform_vertices_avx2 (const transform2d& xform,
+                              const vertex* local, size_t count,
+                              vertex* world);
+bool transform_has_avx2();
+
+#endif
+
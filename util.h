@@ -83,8 +83,8 @@ void syscall_error (const string&);
 //    defined for it.
 //
 
-template <typename item_t>
-ostream& operator<< (ostream& out, const vector<item_t>& vec);
+template <typename item_t, typename alloc_t>
+ostream& operator<< (ostream& out, const vector<item_t,alloc_t>& vec);
 
 
 //
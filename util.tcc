@@ -2,8 +2,8 @@
 
 #include <memory>
 
-template <typename item_t>
-ostream& operator<< (ostream& out, const vector<item_t>& vec) {
+template <typename item_t, typename alloc_t>
+ostream& operator<< (ostream& out, const vector<item_t,alloc_t>& vec) {
    bool want_space = false;
    for (const auto& item: vec) {
       if (want_space) cout << " ";
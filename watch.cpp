@@ -0,0 +1,161 @@
+// $Id$
+
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+using namespace std;
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <GL/freeglut.h>
+
+#include "arena.h"
+#include "debug.h"
+#include "graphics.h"
+#include "trace.h"
+#include "util.h"
+#include "watch.h"
+
+thread* script_watcher::watcher = nullptr;
+int script_watcher::wake_fd = -1;
+atomic<bool> script_watcher::stopping {false};
+
+static mutex edits_lock;
+static deque<interpreter::script_edit> edits;
+static deque<string> failures;      // not tied to an edit
+
+static void fail (const string& object) {
+   string message = object + ": " + strerror (errno);
+   lock_guard<mutex> guard (edits_lock);
+   failures.push_back (move (message));
+}
+
+//
+// Wait up to timeout milliseconds, or forever if negative, for
+// events.  Returns 1 if one of them was for the file name, 0 if not
+// or on timeout, and -1 if the descriptor failed or wake was
+// signalled.
+//
+static int wait_change (int fd, int wake, const string& name,
+                        int timeout) {
+   pollfd ready[] {{fd, POLLIN, 0}, {wake, POLLIN, 0}};
+   int count = ::poll (ready, 2, timeout);
+   if (count < 0) return errno == EINTR ? 0 : -1;
+   if (ready[1].revents != 0) return -1;
+   if (count == 0) return 0;
+   alignas (inotify_event) char buffer[4096];
+   ssize_t length = read (fd, buffer, sizeof buffer);
+   if (length < 0) return errno == EINTR ? 0 : -1;
+   int changed = 0;
+   for (ssize_t offset = 0; offset < length;) {
+      const inotify_event* event
+            = reinterpret_cast<const inotify_event*> (buffer + offset);
+      if (event->len != 0 and name == event->name) changed = 1;
+      offset += sizeof (inotify_event) + event->len;
+   }
+   return changed;
+}
+
+void script_watcher::start (const string& filename,
+                            vector<interpreter::drawing>&& drawn) {
+   shape_arena::disable();
+   size_t slash = filename.rfind ('/');
+   string dir = slash == string::npos ? "." : filename.substr (0, slash + 1);
+   string name = filename.substr (slash + 1);
+   int fd = inotify_init1 (IN_CLOEXEC);
+   if (fd < 0) {
+      syscall_error ("inotify");
+      return;
+   }
+   if (inotify_add_watch (fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO)
+       < 0) {
+      syscall_error (dir);
+      close (fd);
+      return;
+   }
+   wake_fd = eventfd (0, EFD_CLOEXEC);
+   if (wake_fd < 0) {
+      syscall_error ("eventfd");
+      close (fd);
+      return;
+   }
+   DEBUGF ('i', "watching " << name << " in " << dir);
+   watcher = new thread (watch, fd, filename, name, move (drawn));
+   window::at_close (stop);
+   glutTimerFunc (poll_ms, poll, 0);
+}
+
+void script_watcher::stop() {
+   if (watcher == nullptr or not watcher->joinable()) return;
+   stopping = true;
+   uint64_t one = 1;
+   if (write (wake_fd, &one, sizeof one) < 0) syscall_error ("eventfd");
+   watcher->join();
+   close (wake_fd);
+   wake_fd = -1;
+}
+
+void script_watcher::watch (int fd, string filename, string name,
+                            vector<interpreter::drawing> drawn) {
+   while (not stopping) {
+      int changed = wait_change (fd, wake_fd, name, -1);
+      if (changed == 0) continue;
+      while (changed > 0) {
+         changed = wait_change (fd, wake_fd, name, settle_ms);
+      }
+      if (changed < 0) break;
+      reload (filename, drawn);
+   }
+   if (not stopping) fail ("inotify");
+   close (fd);
+}
+
+void script_watcher::reload (const string& filename,
+                             vector<interpreter::drawing>& drawn) {
+   TRACE_SCOPE ('i', "reload", drawn.size());
+   script_source source (filename, false);
+   if (source.fail()) {
+      fail (filename);
+      return;
+   }
+   interpreter::program prog;
+   prog.filename = filename;
+   vector<string> errors;
+   interpreter::compile (source.text(), prog, 0, &errors);
+   if (stopping) return;
+   vector<interpreter::drawing> now;
+   interpreter::define_list defines;
+   interpreter::evaluate (prog, now, defines, &errors);
+   interpreter::script_edit edit = interpreter::diff (drawn, now,
+                                                      move (defines));
+   edit.errors = move (errors);
+   drawn = move (now);
+   lock_guard<mutex> guard (edits_lock);
+   edits.push_back (move (edit));
+}
+
+void script_watcher::poll (int) {
+   deque<interpreter::script_edit> ready;
+   deque<string> failed;
+   {
+      lock_guard<mutex> guard (edits_lock);
+      ready.swap (edits);
+      failed.swap (failures);
+   }
+   for (const auto& message: failed) complain() << message << endl;
+   for (const auto& edit: ready) {
+      for (const auto& error: edit.errors) complain() << error << endl;
+      interpreter::apply (edit);
+   }
+   if (not ready.empty()) {
+      glutPostRedisplay();
+      window::start_animation();
+   }
+   glutTimerFunc (poll_ms, poll, 0);
+}
+
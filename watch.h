@@ -0,0 +1,56 @@
+// $Id$
+
+#ifndef __WATCH_H__
+#define __WATCH_H__
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#include "interp.h"
+
+//
+// script_watcher -
+//    Static class that reloads the input script whenever it is saved.
+//    The script's directory is watched with inotify, rather than the
+//    file, since editors often save by writing a new file and renaming
+//    it over the old one.  A thread waits for a change, lets a burst
+//    of writes settle, then compiles, evaluates and diffs the new text
+//    against the last version.  The main thread only applies the
+//    edits, from a GLUT timer, so the window keeps drawing while a
+//    large script is compiled.  The thread reports nothing itself:
+//    errors go to the main thread with the edit, or on their own if
+//    the script could not be read or inotify failed.
+// start -
+//    Watch filename, whose objects are in the window as drawn.
+//    Needs glutInit.  Shapes made by reloads come from the heap, even
+//    with -m, so each save does not leave the old ones in the arena.
+// stop -
+//    Wake the thread through an eventfd and join it, finishing any
+//    reload under way.  Run when the window closes, before exit
+//    destroys what the thread uses.
+//
+
+class script_watcher {
+   private:
+      static const int settle_ms = 50;
+      static const int poll_ms = 50;
+      static thread* watcher;   // never destroyed, so exit cannot abort
+      static int wake_fd;
+      static atomic<bool> stopping;
+      static void watch (int fd, string filename, string name,
+                         vector<interpreter::drawing> drawn);
+      static void reload (const string& filename,
+                          vector<interpreter::drawing>& drawn);
+      static void poll (int);
+   public:
+      script_watcher() = delete;
+      static void start (const string& filename,
+                         vector<interpreter::drawing>&& drawn);
+      static void stop();
+};
+
+#endif
+